@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "quad.h"
+#include "batch.h"
+
+// Аргументы потока исполнителя: непрерывная группа отсортированных записей.
+struct batch_thread {
+    size_t size_of_structure;
+    struct batch_record *records;
+    struct batch_answer *answers;
+    uint64_t count;
+};
+
+//============================
+// Интерфейс Управляющего узла
+//============================
+
+int start_manager_batch(INFO_MANAGER *manager, size_t num_records, const BATCH_RECORD *records,
+        BATCH_RESULT *results)
+{
+    if (!manager || !records || !results || !num_records || !manager->num_nodes)
+        return -1;
+
+    // Планирование: известные части запоминаются, узлам уходят только остатки.
+    QUAD_PLAN *plans = calloc(num_records, sizeof(*plans));
+    size_t *pending = calloc(num_records, sizeof(*pending));
+    if (!plans || !pending) {
+        free(plans);
+        free(pending);
+        return -1;
+    }
+    size_t num_pending = 0;
+    for (size_t i = 0; i < num_records; ++i) {
+        results[i].value = NAN;
+        results[i].num_steps = 0;
+        // Запись с неподдерживаемой функцией уходит как есть, узел вернёт для неё NAN.
+        if (!quad_plan(records[i].func, records[i].left, records[i].right, records[i].plan, &plans[i]) &&
+                plans[i].left == plans[i].right) {
+            results[i].value = plans[i].known;
+            continue;
+        }
+        pending[num_pending++] = i;
+    }
+    if (!num_pending) {
+        free(plans);
+        free(pending);
+        return 0;
+    }
+
+    // Все задачи одного размера: узлы получают поровну записей с точностью до одной.
+    size_t num_nodes = manager->num_nodes;
+    size_t per_node = (num_pending + num_nodes - 1) / num_nodes;
+    size_t task_size = sizeof(struct batch_task) + per_node * sizeof(struct batch_record);
+    size_t ans_size = num_nodes * sizeof(struct batch_result) + num_pending * sizeof(struct batch_answer);
+
+    char *tasks = calloc(num_nodes, task_size);
+    char *ans = calloc(ans_size, 1);
+    if (!tasks || !ans) {
+        free(tasks);
+        free(ans);
+        free(plans);
+        free(pending);
+        return -1;
+    }
+
+    size_t next = 0;
+    for (size_t node = 0; node < num_nodes; ++node) {
+        struct batch_task *task = (struct batch_task *)(tasks + node * task_size);
+        task->size_of_structure = task_size;
+        task->count = num_pending / num_nodes + (node < num_pending % num_nodes);
+        for (uint64_t i = 0; i < task->count; ++i, ++next) {
+            size_t index = pending[next];
+            task->records[i].index = index;
+            task->records[i].func = records[index].func;
+            task->records[i].left = plans[index].left;
+            task->records[i].right = plans[index].right;
+            task->records[i].tolerance = records[index].tolerance;
+        }
+    }
+
+    if (start_manager_bounded(manager, task_size, num_nodes, tasks, ans, ans_size)) {
+        free(tasks);
+        free(ans);
+        free(plans);
+        free(pending);
+        return -1;
+    }
+
+    // Ответы приходят в порядке завершения узлов; записи возвращаются на свои места по номерам.
+    char *ptr = ans;
+    for (size_t node = 0; node < num_nodes; ++node) {
+        struct batch_result *res = (struct batch_result *)ptr;
+        if (ptr + sizeof(*res) + res->count * sizeof(res->answers[0]) > ans + ans_size) {
+            fprintf(stderr, "[start_manager_batch] Malformed answer\n");
+            break;
+        }
+        for (uint64_t i = 0; i < res->count; ++i) {
+            if (res->answers[i].index >= num_records)
+                continue;
+            results[res->answers[i].index].value = plans[res->answers[i].index].known + res->answers[i].value;
+            results[res->answers[i].index].num_steps = res->answers[i].num_steps;
+        }
+        ptr += sizeof(*res) + res->count * sizeof(res->answers[0]);
+    }
+
+    free(tasks);
+    free(ans);
+    free(plans);
+    free(pending);
+    return 0;
+}
+
+//============================
+// Интерфейс исполнителя
+//============================
+
+static int batch_record_cmp(const void *a, const void *b)
+{
+    const struct batch_record *ra = a, *rb = b;
+    if (ra->func != rb->func)
+        return ra->func < rb->func ? -1 : 1;
+    if (ra->left != rb->left)
+        return ra->left < rb->left ? -1 : 1;
+    return 0;
+}
+
+int batch_data_for_threads(INFO_WORKER *worker)
+{
+    struct batch_task *task = (struct batch_task *)worker->data;
+    if (!task || worker->n_cores <= 0)
+        return -1;
+    if (task->size_of_structure < sizeof(*task) ||
+            task->count > (task->size_of_structure - sizeof(*task)) / sizeof(task->records[0])) {
+        fprintf(stderr, "[batch_data_for_threads] Malformed task\n");
+        return -1;
+    }
+
+    uint64_t count = task->count;
+    size_t n_threads = worker->n_cores;
+    char *block = calloc(1, n_threads * sizeof(struct batch_thread) +
+            count * (sizeof(struct batch_record) + sizeof(struct batch_answer)));
+    if (!block) return -1;
+
+    struct batch_thread *threads = (struct batch_thread *)block;
+    struct batch_record *records = (struct batch_record *)(threads + n_threads);
+    struct batch_answer *answers = (struct batch_answer *)(records + count);
+
+    // Записи с одной функцией идут подряд, и поток считает их одним ядром.
+    memcpy(records, task->records, count * sizeof(*records));
+    qsort(records, count, sizeof(*records), batch_record_cmp);
+
+    double total_cost = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        answers[i].index = records[i].index;
+        answers[i].num_steps = quad_num_steps(records[i].func, records[i].left, records[i].right,
+                records[i].tolerance);
+        total_cost += answers[i].num_steps;
+    }
+
+    // Непрерывные группы примерно равной стоимости.
+    uint64_t begin = 0;
+    double cost = 0;
+    for (size_t t = 0; t < n_threads; ++t) {
+        uint64_t end = begin;
+        double target = total_cost * (t + 1) / n_threads;
+        while (end < count && (t == n_threads - 1 || cost + answers[end].num_steps / 2.0 <= target)) {
+            cost += answers[end].num_steps;
+            ++end;
+        }
+        threads[t].size_of_structure = sizeof(threads[t]);
+        threads[t].records = records + begin;
+        threads[t].answers = answers + begin;
+        threads[t].count = end - begin;
+        begin = end;
+    }
+
+    worker->data = block;
+    worker->size_of_structure = sizeof(struct batch_thread);
+    free(task);
+    return 0;
+}
+
+void *batch_thread_func(void *t_args)
+{
+    struct batch_thread *args = (struct batch_thread *)t_args;
+
+    for (uint64_t i = 0; i < args->count; ++i) {
+        if (worker_cancelled())
+            break;
+        const struct batch_record *rec = &args->records[i];
+        struct batch_answer *answer = &args->answers[i];
+        if (answer->num_steps == 0) {
+            answer->value = NAN;
+            continue;
+        }
+        double step = (rec->right - rec->left) / answer->num_steps;
+        answer->value = quad_midpoint(rec->func, rec->left, step, answer->num_steps);
+    }
+    return NULL;
+}
+
+int batch_collect(INFO_WORKER *worker)
+{
+    struct batch_thread *threads = (struct batch_thread *)worker->data;
+    uint64_t count = 0;
+    for (int t = 0; t < worker->n_cores; ++t)
+        count += threads[t].count;
+
+    size_t size = sizeof(struct batch_result) + count * sizeof(struct batch_answer);
+    char *result = realloc(worker->result, size);
+    if (!result) {
+        fprintf(stderr, "[batch_collect] Unable to allocate memory\n");
+        return -1;
+    }
+
+    struct batch_result *res = (struct batch_result *)result;
+    res->count = count;
+    memcpy(res->answers, threads[0].answers, count * sizeof(struct batch_answer));
+    worker->result = result;
+    worker->size_of_result = size;
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+//================
+// Пакетное вычисление множества одномерных интегралов за одно распределение задач.
+//================
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "manager.h"
+#include "worker.h"
+
+//! Описание одного интеграла пакета.
+typedef struct
+{
+    // Подынтегральная функция.
+    FUNC_TABLE func;
+    // Отрезок интегрирования.
+    double left;
+    double right;
+    // Допустимая погрешность.
+    double tolerance;
+    // Разрешённые упрощения до распределения задач (QUAD_PLAN_FLAGS, 0 - только численно).
+    unsigned plan;
+} BATCH_RECORD;
+
+//! Результат вычисления одного интеграла пакета.
+typedef struct
+{
+    // Значение интеграла.
+    double value;
+    // Количество шагов квадратурной формулы (0 - запись не была вычислена численно:
+    // при ошибке значение равно NAN, иначе найдено по первообразной).
+    uint64_t num_steps;
+} BATCH_RESULT;
+
+// Запись пакета в том виде, в котором она передаётся по сети.
+struct batch_record {
+    // Номер записи во входном массиве.
+    uint64_t index;
+    uint32_t func;
+    uint32_t reserved;
+    double left;
+    double right;
+    double tolerance;
+};
+
+// Задача рабочего узла: часть пакета.
+struct batch_task {
+    // Размер структуры вместе с записями (по соглашению библиотеки - первое поле задачи).
+    size_t size_of_structure;
+    // Количество записей.
+    uint64_t count;
+    struct batch_record records[];
+};
+
+// Результат одной записи в том виде, в котором он передаётся по сети.
+struct batch_answer {
+    uint64_t index;
+    uint64_t num_steps;
+    double value;
+};
+
+// Ответ рабочего узла: результаты всех его записей.
+struct batch_result {
+    uint64_t count;
+    struct batch_answer answers[];
+};
+
+/*!
+ * \brief Функция для вычисления пакета интегралов.
+ *
+ * \param[in] manager Структура INFO_MANAGER, инициализированная функцией info_manager_init.
+ * \param[in] num_records Количество интегралов в пакете.
+ * \param[in] records Описания интегралов.
+ * \param[out] results Массив из num_records результатов в порядке входных записей.
+ *
+ * \return Возвращает 0 в случае успеха, -1 при возникновении ошибок.
+ *
+ * \details Все записи распределяются по рабочим узлам за одно подключение,
+ *          поэтому затраты на подключение и рукопожатие делятся на весь пакет.
+ *          Перед распределением записи упрощаются функцией quad_plan согласно полю plan:
+ *          узлам отправляются только остатки, требующие численного интегрирования.
+ *          Если таких записей нет, рабочие узлы не используются.
+ */
+int start_manager_batch(INFO_MANAGER *manager, size_t num_records, const BATCH_RECORD *records,
+        BATCH_RESULT *results);
+
+// Группировка записей по функциям и разбиение их по ядрам исполнителя.
+int batch_data_for_threads(INFO_WORKER *worker);
+
+// Процедура потока: вычисление своей группы записей.
+void *batch_thread_func(void *t_args);
+
+// Формирование ответа в worker->result.
+int batch_collect(INFO_WORKER *worker);
+
+#endif // BATCH_H
@@ -1,3 +1,9 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stdint.h>
+#include <time.h>
+
 typedef enum
 {
     EXP,
@@ -10,7 +16,48 @@ struct worker_result {
     double value;
 };
 
+// Задача начинается со своего полного размера; особые значения размера - служебные сообщения
+// Управляющего узла: задач больше нет и отмена задания (выданные задачи не нужны).
+#define TASK_SIZE_END 0
+#define TASK_SIZE_CANCEL SIZE_MAX
+
+//! Типы сообщений от рабочего узла Управляющему узлу.
+typedef enum
+{
+    // Результат задачи.
+    MSG_ANSWER = 1,
+    // События трассировки рабочего узла.
+    MSG_TRACE,
+    // Промежуточный результат выполняемой задачи (struct partial_result).
+    MSG_PARTIAL,
+    // Выполняемая задача не уложилась в max_time рабочего узла и возвращается в очередь (без данных).
+    MSG_EXPIRED,
+} MSG_TYPE;
+
+//! Заголовок сообщения от рабочего узла; за ним следуют size байт данных.
+struct msg_header {
+    uint32_t type;
+    // Для MSG_ANSWER - время вычисления задачи в микросекундах (0 - неизвестно).
+    uint32_t compute_us;
+    uint64_t size;
+};
+
+//! Промежуточный результат самой ранней из выданных узлу и ещё не выполненных задач.
+struct partial_result {
+    // Оценка результата всей задачи (первого поля double ответа) и оценка её погрешности.
+    double value;
+    double error;
+    // Доля выполненной работы от 0 до 1.
+    double coverage;
+};
+
+//! Данные об узле, передаваемые рабочим узлом при подключении.
 struct node_info {
-    time_t max_worker_time;
-    int n_cores;
+    int32_t n_cores;
+    // Кредиты: сколько задач узел готов держать у себя одновременно (0 равносильно 1).
+    uint32_t credits;
+    // Профиль узла: вычислений каждой функции FUNC_TABLE в секунду на одно ядро (0 - неизвестно).
+    double evals_per_sec[NOT_SUPPORT];
 };
+
+#endif // COMMON_H
@@ -0,0 +1,443 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "trace.h"
+#include "log.h"
+
+// Количество записей в кольцевом буфере потока (степень двойки).
+#define LOG_RING_SIZE 512
+// Пауза потока вывода, когда записей нет.
+#define LOG_IDLE_NS 1000000
+// Максимальная длина спецификации преобразования вместе с завершающим нулём.
+#define LOG_SPEC_MAX 24
+
+union log_arg {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const void *p;
+};
+
+//! Двоичная запись журнала: форматирование откладывается до потока вывода.
+struct log_record {
+    uint64_t ts_ns;
+    const char *fmt;
+    uint32_t level;
+    uint32_t nargs;
+    union log_arg args[LOG_MAX_ARGS];
+    // Копии строковых аргументов; в args хранится смещение.
+    char str[LOG_STR_MAX];
+};
+
+//! Состояния кольцевого буфера
+typedef enum
+{
+    RING_OWNED,  // -> RING_CLOSED
+    RING_CLOSED, // -> RING_FREE
+    RING_FREE,   // -> RING_OWNED
+} RING_STATE;
+
+// Кольцевой буфер с одним писателем (поток-владелец) и одним читателем (поток вывода).
+struct log_ring {
+    _Atomic int state;
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+    uint64_t reported_dropped;
+    struct log_record records[LOG_RING_SIZE];
+    // Список всех буферов; поле не меняется после добавления в список.
+    struct log_ring *next;
+};
+
+int log_level = LOG_LEVEL_INFO;
+
+static _Atomic(struct log_ring *) log_rings = NULL;
+static _Thread_local struct log_ring *local_ring = NULL;
+static pthread_key_t ring_key;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_t log_thread;
+static _Atomic bool log_running = false;
+static _Atomic bool log_stop = false;
+static uint64_t log_base_ns = 0;
+static FILE *log_out = NULL;
+
+static const char LEVEL_NAMES[] = "DIWE";
+
+__attribute__((constructor))
+static void log_read_env(void)
+{
+    static const char *names[] = { "debug", "info", "warn", "error", "off" };
+    const char *env = getenv("SPECSEM_LOG");
+    if (!env)
+        return;
+    for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_OFF; ++level) {
+        if (!strcasecmp(env, names[level])) {
+            log_level = level;
+            return;
+        }
+    }
+    fprintf(stderr, "[log] Unknown SPECSEM_LOG value %s\n", env);
+}
+
+//============================
+// Разбор формата
+//============================
+
+//! Модификаторы длины
+typedef enum
+{
+    LEN_NONE,
+    LEN_HH,
+    LEN_H,
+    LEN_L,
+    LEN_LL,
+    LEN_Z,
+    LEN_J,
+    LEN_T,
+    LEN_BIG_L,
+} LENGTH_MOD;
+
+struct log_spec {
+    // Флаги, ширина и точность без модификатора длины: "%-8.3".
+    char prefix[LOG_SPEC_MAX];
+    LENGTH_MOD length;
+    char conv;
+    const char *end;
+};
+
+// Разбор спецификации, начинающейся с '%'; false - спецификация не поддерживается.
+static bool parse_spec(const char *p, struct log_spec *spec)
+{
+    const char *start = p++;
+    while (*p && strchr("-+ #0123456789.", *p))
+        ++p;
+    size_t prefix_len = p - start;
+    if (prefix_len >= LOG_SPEC_MAX - 4)
+        return false;
+    memcpy(spec->prefix, start, prefix_len);
+    spec->prefix[prefix_len] = '\0';
+
+    spec->length = LEN_NONE;
+    switch (*p) {
+    case 'h':
+        spec->length = p[1] == 'h' ? LEN_HH : LEN_H;
+        p += spec->length == LEN_HH ? 2 : 1;
+        break;
+    case 'l':
+        spec->length = p[1] == 'l' ? LEN_LL : LEN_L;
+        p += spec->length == LEN_LL ? 2 : 1;
+        break;
+    case 'z': spec->length = LEN_Z; ++p; break;
+    case 'j': spec->length = LEN_J; ++p; break;
+    case 't': spec->length = LEN_T; ++p; break;
+    case 'L': spec->length = LEN_BIG_L; ++p; break;
+    }
+
+    if (!*p || !strchr("diouxXcfFeEgGaAspn", *p))
+        return false;
+    spec->conv = *p;
+    spec->end = p + 1;
+    return true;
+}
+
+static bool is_signed_conv(char conv)
+{
+    return conv == 'd' || conv == 'i';
+}
+
+static bool is_float_conv(char conv)
+{
+    return strchr("fFeEgGaA", conv) != NULL;
+}
+
+// Чтение целого аргумента по модификатору длины.
+static union log_arg read_int(va_list *ap, const struct log_spec *spec)
+{
+    union log_arg arg;
+    bool sign = is_signed_conv(spec->conv);
+
+    switch (spec->length) {
+    case LEN_L:
+        if (sign) arg.i = va_arg(*ap, long); else arg.u = va_arg(*ap, unsigned long);
+        break;
+    case LEN_LL:
+        if (sign) arg.i = va_arg(*ap, long long); else arg.u = va_arg(*ap, unsigned long long);
+        break;
+    case LEN_Z:
+        if (sign) arg.i = va_arg(*ap, ssize_t); else arg.u = va_arg(*ap, size_t);
+        break;
+    case LEN_J:
+        if (sign) arg.i = va_arg(*ap, intmax_t); else arg.u = va_arg(*ap, uintmax_t);
+        break;
+    case LEN_T:
+        arg.i = va_arg(*ap, ptrdiff_t);
+        break;
+    default:
+        // char и short передаются как int; приведение выполнит printf.
+        if (sign) arg.i = va_arg(*ap, int); else arg.u = va_arg(*ap, unsigned int);
+    }
+    return arg;
+}
+
+// Копирование аргументов в запись; разбор останавливается на первой неподдерживаемой
+// спецификации, остаток формата выводится как есть.
+static void capture_args(struct log_record *record, va_list *ap)
+{
+    size_t str_used = 0;
+    struct log_spec spec;
+
+    record->nargs = 0;
+    for (const char *p = record->fmt; (p = strchr(p, '%'));) {
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+        if (record->nargs == LOG_MAX_ARGS || !parse_spec(p, &spec))
+            break;
+
+        union log_arg *arg = &record->args[record->nargs++];
+        if (is_float_conv(spec.conv)) {
+            arg->d = spec.length == LEN_BIG_L ? (double)va_arg(*ap, long double) : va_arg(*ap, double);
+        } else if (spec.conv == 's') {
+            const char *s = va_arg(*ap, const char *);
+            if (!s)
+                s = "(null)";
+            size_t left = LOG_STR_MAX - str_used;
+            size_t len = strnlen(s, left ? left - 1 : 0);
+            arg->u = str_used;
+            if (left) {
+                memcpy(record->str + str_used, s, len);
+                record->str[str_used + len] = '\0';
+                str_used += len + 1;
+            } else {
+                arg->u = LOG_STR_MAX - 1;
+            }
+        } else if (spec.conv == 'p' || spec.conv == 'n') {
+            arg->p = va_arg(*ap, void *);
+        } else if (spec.conv == 'c') {
+            arg->i = va_arg(*ap, int);
+        } else {
+            arg->u = read_int(ap, &spec).u;
+        }
+        p = spec.end;
+    }
+}
+
+static void format_record(FILE *out, const struct log_record *record)
+{
+    struct log_spec spec;
+    uint32_t arg_i = 0;
+    const char *p = record->fmt;
+
+    fprintf(out, "[%c %.6f] ", LEVEL_NAMES[record->level],
+            (int64_t)(record->ts_ns - log_base_ns) / 1e9);
+    for (const char *next; (next = strchr(p, '%'));) {
+        fwrite(p, 1, next - p, out);
+        if (next[1] == '%') {
+            fputc('%', out);
+            p = next + 2;
+            continue;
+        }
+        if (arg_i == record->nargs || !parse_spec(next, &spec)) {
+            p = next;
+            break;
+        }
+
+        const union log_arg *arg = &record->args[arg_i++];
+        char fmt[LOG_SPEC_MAX + 4];
+        if (is_float_conv(spec.conv)) {
+            snprintf(fmt, sizeof(fmt), "%s%c", spec.prefix, spec.conv);
+            fprintf(out, fmt, arg->d);
+        } else if (spec.conv == 's') {
+            snprintf(fmt, sizeof(fmt), "%ss", spec.prefix);
+            fprintf(out, fmt, record->str + arg->u);
+        } else if (spec.conv == 'p') {
+            snprintf(fmt, sizeof(fmt), "%sp", spec.prefix);
+            fprintf(out, fmt, arg->p);
+        } else if (spec.conv == 'n') {
+            // %n не выполняется: указатель может быть уже недействителен.
+        } else if (spec.conv == 'c') {
+            snprintf(fmt, sizeof(fmt), "%sc", spec.prefix);
+            fprintf(out, fmt, (int)arg->i);
+        } else {
+            // Целые выводятся как long long с тем же приведением, что сделал бы printf.
+            int64_t value = arg->i;
+            bool sign = is_signed_conv(spec.conv);
+            if (spec.length == LEN_HH)
+                value = sign ? (int64_t)(signed char)value : (int64_t)(unsigned char)value;
+            else if (spec.length == LEN_H)
+                value = sign ? (int64_t)(short)value : (int64_t)(unsigned short)value;
+            else if (spec.length == LEN_NONE)
+                value = sign ? (int64_t)(int)value : (int64_t)(unsigned int)value;
+            snprintf(fmt, sizeof(fmt), "%sll%c", spec.prefix, spec.conv);
+            fprintf(out, fmt, (long long)value);
+        }
+        p = spec.end;
+    }
+    fputs(p, out);
+    fputc('\n', out);
+}
+
+//============================
+// Буферы потоков
+//============================
+
+static void ring_release(void *ring)
+{
+    atomic_store_explicit(&((struct log_ring *)ring)->state, RING_CLOSED, memory_order_release);
+}
+
+static struct log_ring *ring_acquire(void)
+{
+    struct log_ring *ring;
+
+    for (ring = atomic_load_explicit(&log_rings, memory_order_acquire); ring; ring = ring->next) {
+        int expected = RING_FREE;
+        if (atomic_compare_exchange_strong(&ring->state, &expected, RING_OWNED))
+            break;
+    }
+
+    if (!ring) {
+        ring = calloc(1, sizeof(*ring));
+        if (!ring)
+            return NULL;
+        ring->state = RING_OWNED;
+        ring->next = atomic_load_explicit(&log_rings, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&log_rings, &ring->next, ring,
+                    memory_order_release, memory_order_relaxed))
+            ;
+    }
+
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+// Вывод накопленных записей всех буферов; возвращает число выведенных записей.
+static size_t log_drain(void)
+{
+    size_t count = 0;
+
+    for (struct log_ring *ring = atomic_load_explicit(&log_rings, memory_order_acquire); ring; ring = ring->next) {
+        int state = atomic_load_explicit(&ring->state, memory_order_acquire);
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+        for (; tail < head; ++tail, ++count)
+            format_record(log_out, &ring->records[tail % LOG_RING_SIZE]);
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+        uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->reported_dropped) {
+            fprintf(log_out, "[log] %lu records dropped\n", dropped - ring->reported_dropped);
+            ring->reported_dropped = dropped;
+        }
+
+        if (state == RING_CLOSED)
+            atomic_store_explicit(&ring->state, RING_FREE, memory_order_release);
+    }
+    return count;
+}
+
+static void *log_thread_func(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        bool stop = atomic_load_explicit(&log_stop, memory_order_acquire);
+        if (log_drain())
+            fflush(log_out);
+        if (stop)
+            break;
+        struct timespec idle = { 0, LOG_IDLE_NS };
+        nanosleep(&idle, NULL);
+    }
+    return NULL;
+}
+
+static void log_start(void)
+{
+    pthread_key_create(&ring_key, ring_release);
+    log_base_ns = trace_now_ns();
+
+    // Собственный буферизованный поток вывода: записи выводятся пачками.
+    int fd = dup(STDERR_FILENO);
+    log_out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!log_out) {
+        if (fd >= 0)
+            close(fd);
+        log_out = stderr;
+    }
+
+    if (pthread_create(&log_thread, NULL, log_thread_func, NULL)) {
+        fprintf(stderr, "[log_init] Unable to create log thread, logging synchronously\n");
+        return;
+    }
+    atomic_store_explicit(&log_running, true, memory_order_release);
+    atexit(log_shutdown);
+}
+
+void log_init(void)
+{
+    pthread_once(&log_once, log_start);
+}
+
+void log_shutdown(void)
+{
+    if (!atomic_exchange(&log_running, false))
+        return;
+    atomic_store_explicit(&log_stop, true, memory_order_release);
+    pthread_join(log_thread, NULL);
+    fflush(log_out);
+}
+
+void log_write(int level, const char *fmt, ...)
+{
+    if (level < LOG_LEVEL_DEBUG || level >= LOG_LEVEL_OFF)
+        return;
+    if (!local_ring) {
+        log_init();
+        local_ring = ring_acquire();
+    }
+
+    struct log_record sync_record;
+    struct log_record *record = &sync_record;
+    struct log_ring *ring = local_ring;
+    bool running = atomic_load_explicit(&log_running, memory_order_acquire);
+    uint64_t head = 0;
+
+    if (running && ring) {
+        head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - tail == LOG_RING_SIZE) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        }
+        record = &ring->records[head % LOG_RING_SIZE];
+    }
+
+    record->ts_ns = trace_now_ns();
+    record->fmt = fmt;
+    record->level = level;
+    va_list ap;
+    va_start(ap, fmt);
+    capture_args(record, &ap);
+    va_end(ap);
+
+    if (record != &sync_record) {
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    } else {
+        // Поток вывода не запущен или уже остановлен.
+        format_record(stderr, record);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef LOG_H
+#define LOG_H
+
+//================
+// Асинхронный журнал с уровнями.
+//================
+// Вызов журнала копирует формат и аргументы в двоичную запись кольцевого буфера
+// своего потока без блокировок и без форматирования; отдельный поток форматирует
+// записи и выводит их в stderr.
+//
+// Ограничения формата: поддерживаются преобразования printf без '*' в ширине
+// и точности; строки %s копируются в запись и обрезаются до LOG_STR_MAX байт.
+// Формат должен быть строковой константой: в записи хранится только указатель.
+#include <stdint.h>
+
+//! Уровни журнала
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF   4
+
+// Минимальный уровень, попадающий в сборку: вызовы ниже него удаляются
+// препроцессором (например, -DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO).
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+//! Максимальное число аргументов одной записи.
+#define LOG_MAX_ARGS 8
+//! Место под копии строковых аргументов одной записи.
+#define LOG_STR_MAX 64
+
+// Минимальный уровень во время работы; начальное значение берётся из
+// переменной окружения SPECSEM_LOG (debug, info, warn, error, off), по умолчанию info.
+extern int log_level;
+
+// Запуск потока вывода (вызывается автоматически при первой записи).
+void log_init(void);
+
+// Запись в буфер текущего потока; при переполнении буфера запись отбрасывается.
+void log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Вывод всех накопленных записей и остановка потока вывода (регистрируется через atexit).
+void log_shutdown(void);
+
+#define LOG_AT(level, ...)                              \
+    do {                                                \
+        if (__builtin_expect((level) >= log_level, 0))  \
+            log_write((level), __VA_ARGS__);            \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif // LOG_H
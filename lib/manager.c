@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -22,6 +24,13 @@
 #include <sched.h>
 #include <pthread.h>
 #include <netdb.h>
+#include <sys/eventfd.h>
+#include "common.h"
+#include "trace.h"
+#include "log.h"
+#include "metrics.h"
+#include "record.h"
+#include "mc.h"
 #include "manager.h"
 
 //! Состояния рабочего узла
@@ -29,11 +38,78 @@ typedef enum
 {
     CONNECTION_EMPTY,
     GET_INFO,   // -> WAIT_TASK
-    WAIT_TASK, //-> WAIT_ANS, WORK_FINISHED 
-    WAIT_ANS, // -> WAIT_TASK
+    WAIT_TASK, //-> WAIT_ANS, WORK_FINISHED
+    WAIT_ANS, // -> WAIT_TASK, WORK_FINISHED
     WORK_FINISHED
 } WORKER_STATE;
 
+// Верхняя граница кредитов, заявленных рабочим узлом.
+#define MANAGER_MAX_CREDITS 64
+
+// Квантиль нормального распределения для погрешности экстраполяции по истечении времени (95%).
+#define MANAGER_ESTIMATE_Z 1.96
+
+// Первые элементы массива pollfds: слушающий сокет и пробуждение цикла.
+#define POLL_LISTEN 0
+#define POLL_WAKEUP 1
+#define POLL_CONNS  2
+
+//! Состояние задания в планировщике
+typedef struct
+{
+    MANAGER_JOB *job;
+    // Номер следующей ещё не выданной задачи.
+    size_t next_task;
+    // Задачи, возвращённые в очередь после отключения рабочих узлов.
+    size_t *requeued;
+    size_t num_requeued;
+    // Виртуальное время взвешенной справедливой очереди: растёт на 1 / weight с каждой выданной задачей.
+    double vtime;
+    // Поля выше защищены блокировкой списка заданий, поля ниже обновляются атомарно
+    // циклом, получившим ответ.
+    // Занятая ответами часть области ans и количество полученных ответов.
+    atomic_size_t ans_used;
+    atomic_size_t num_answers;
+    // Сумма первых полей double полученных ответов и сумма их квадратов (если запрошена оценка).
+    _Atomic double answered;
+    _Atomic double answered_sq;
+} JOB_STATE;
+
+//! Активные задания Управляющего узла
+typedef struct
+{
+    JOB_STATE **jobs;
+    size_t num_jobs;
+    size_t capacity;
+    // Виртуальное время системы: метка последней выданной задачи; новые задания начинают с неё.
+    double vtime;
+} JOB_LIST;
+
+//! Планировщик заданий
+struct manager_sched {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    // Задания, ещё не принятые циклом Управляющего узла.
+    MANAGER_JOB **submitted;
+    size_t num_submitted;
+    size_t cap_submitted;
+    // Новых заданий не будет.
+    bool closed;
+    // Пробуждение первого цикла Управляющего узла при появлении задания.
+    int wake_fd;
+};
+
+//! Задача, выданная рабочему узлу и ещё не выполненная
+struct in_flight_task {
+    JOB_STATE *job;
+    size_t task_i;
+    // Время отправки задачи (для выравнивания часов при трассировке).
+    uint64_t sent_ns;
+    // Последний промежуточный результат задачи.
+    struct partial_result partial;
+    bool has_partial;
+};
+
 //! Дескриптор рабочего узла
 typedef struct
 {
@@ -43,28 +119,95 @@ typedef struct
     int n_cores;
     // Текущее состояние рабочего узла.
     WORKER_STATE state;
+    // Сколько задач узел готов держать у себя одновременно.
+    uint32_t credits;
+    // Выданные задачи в порядке выдачи (кольцо на credits элементов): узел выполняет
+    // задачи по очереди, поэтому ответы приходят в том же порядке (в состоянии WAIT_ANS).
+    struct in_flight_task *in_flight;
+    uint32_t in_flight_head;
+    uint32_t num_in_flight;
+    // Буфер приёма ответа: в область ответов задания ответ копируется после резервирования места.
+    char *ans_buf;
+    size_t ans_cap;
+    // Смещение часов рабочего узла по обмену с наименьшей задержкой.
+    int64_t clock_offset_ns;
+    uint64_t clock_delay_ns;
+    // Метрики узла (NULL, если метрики выключены).
+    struct metrics_worker *metrics;
+    // Сквозной номер соединения по всем циклам (метрики, трассировка, запись протокола).
+    uint32_t id;
+    // Режим низкой задержки: время отправки задач записывается всегда для замера задержки обмена.
+    bool busy_poll;
+    // Профиль узла: вычислений каждой функции в секунду на одно ядро (0 - неизвестно).
+    double evals_per_sec[NOT_SUPPORT];
 } WORKER_CONN;
 
-static void poll_server_wait_for_worker(struct pollfd* pollfds, INFO_MANAGER* server)
+typedef struct manager_shard MANAGER_SHARD;
+
+//! Общее состояние циклов Управляющего узла
+typedef struct
+{
+    INFO_MANAGER *manager;
+    MANAGER_SCHED *sched;
+    // Блокировка списка заданий: берётся только на время выбора задач и возврата их в очередь,
+    // обмен данными с узлами выполняется без неё.
+    pthread_mutex_t lock;
+    JOB_LIST jobs;
+    // Подключённые узлы для планирования заданий (под той же блокировкой).
+    MANAGER_CLUSTER cluster;
+    // Крайний срок работы после старта (используется только первым циклом).
+    int64_t deadline_ms;
+    // Первый цикл работает в вызывающем потоке: принимает задания, проверяет кворум и время.
+    MANAGER_SHARD *shards;
+    size_t num_shards;
+    // Узлы, передавшие данные о себе (для кворума).
+    atomic_size_t num_init_workers;
+    atomic_uint next_conn_id;
+    atomic_bool started;
+    atomic_bool stop;
+    // Цикл в отдельном потоке завершился с ошибкой.
+    atomic_bool failed;
+} MANAGER_LOOP;
+
+//! Цикл обработки соединений
+struct manager_shard {
+    MANAGER_LOOP *loop;
+    // Слушающий сокет цикла: при нескольких циклах все сокеты открыты с SO_REUSEPORT
+    // на одном адресе, и подключения между ними распределяет ядро.
+    int listen_sock_fd;
+    // Пробуждение цикла (у первого цикла - eventfd планировщика).
+    int wake_fd;
+    WORKER_CONN *works;
+    struct pollfd *pollfds;
+    size_t num_conns;
+    size_t capacity;
+    pthread_t thread;
+    // Задержки обмена в режиме низкой задержки (объединяются после остановки циклов).
+    uint64_t *latencies;
+    size_t num_latencies;
+    size_t cap_latencies;
+};
+
+static void poll_server_wait_for_worker(struct pollfd* pollfds, int listen_sock_fd)
 {
-    struct pollfd* pollfd = &pollfds[0U];
+    struct pollfd* pollfd = &pollfds[POLL_LISTEN];
 
-    pollfd->fd      = server->listen_sock_fd;
+    pollfd->fd      = listen_sock_fd;
     pollfd->events  = POLLIN;
     pollfd->revents = 0U;
 }
 
-static void poll_server_do_not_wait_for_workers(struct pollfd* pollfds)
+static void poll_manager_wait_for_wakeup(struct pollfd* pollfds, int wake_fd)
 {
-    struct pollfd* pollfd = &pollfds[0U];
+    struct pollfd* pollfd = &pollfds[POLL_WAKEUP];
 
-    pollfd->fd      = -1;
-    pollfd->events  = 0U;
+    pollfd->fd      = wake_fd;
+    pollfd->events  = POLLIN;
     pollfd->revents = 0U;
 }
 
 static void poll_manager_wait_for_answer(struct pollfd* pollfds, size_t conn_i, WORKER_CONN *work) {
-    struct pollfd* pollfd = &pollfds[1 + conn_i];
+    struct pollfd* pollfd = &pollfds[POLL_CONNS + conn_i];
 
     pollfd->fd      = work->worker_sock_fd;
     pollfd->events  = POLLIN | POLLHUP;
@@ -72,7 +215,7 @@ static void poll_manager_wait_for_answer(struct pollfd* pollfds, size_t conn_i,
 }
 
 static void poll_manager_do_not_wait_for_ans(struct pollfd* pollfds, size_t conn_i){
-    struct pollfd* pollfd = &pollfds[conn_i + 1];
+    struct pollfd* pollfd = &pollfds[POLL_CONNS + conn_i];
 
     pollfd->fd      = -1;
     pollfd->events  = 0U;
@@ -80,7 +223,7 @@ static void poll_manager_do_not_wait_for_ans(struct pollfd* pollfds, size_t conn
 }
 
 static void poll_manager_wait_work_info(struct pollfd* pollfds, size_t conn_i, WORKER_CONN *work) {
-    struct pollfd* pollfd = &pollfds[1 + conn_i];
+    struct pollfd* pollfd = &pollfds[POLL_CONNS + conn_i];
 
     pollfd->fd      = work->worker_sock_fd;
     pollfd->events  = POLLIN|POLLHUP;
@@ -90,46 +233,66 @@ static void poll_manager_wait_work_info(struct pollfd* pollfds, size_t conn_i, W
 //============================
 // Процедуры сервера
 //============================
-static bool manager_init_socket(INFO_MANAGER* manager)
+
+// Слушающий сокет на адресе Управляющего узла; -1 при ошибке.
+static int manager_listen_socket(INFO_MANAGER* manager, bool reuse_port)
 {
-    if (manager->is_init == false) {
-        fprintf(stderr, "[manager_init] Not init Info Manager!\n");
-        return false;
-    }
     // Создаём сокет, слушающий подключения клиентов.
-    manager->listen_sock_fd = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK, 0);
-    if (manager->listen_sock_fd == -1)
+    int listen_sock_fd = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK, 0);
+    if (listen_sock_fd == -1)
     {
         fprintf(stderr, "[manager_init] Unable to create socket!\n");
-        return false;
+        return -1;
     }
 
     // Запрещаем перевод слушающего сокета в состояние TIME_WAIT.
     int setsockopt_yes = 1;
-    if (setsockopt(manager->listen_sock_fd, SOL_SOCKET, SO_REUSEADDR, &setsockopt_yes, sizeof(setsockopt_yes)) == -1)
+    if (setsockopt(listen_sock_fd, SOL_SOCKET, SO_REUSEADDR, &setsockopt_yes, sizeof(setsockopt_yes)) == -1)
     {
         fprintf(stderr, "[manager_init] Unable to set SO_REUSEADDR socket option\n");
-        return false;
+        close(listen_sock_fd);
+        return -1;
     }
 
-    if (bind(manager->listen_sock_fd, (struct sockaddr*) &(manager->listen_addr), sizeof(manager->listen_addr)) == -1)
+    // Несколько циклов слушают один адрес, ядро распределяет подключения между их сокетами.
+    if (reuse_port &&
+            setsockopt(listen_sock_fd, SOL_SOCKET, SO_REUSEPORT, &setsockopt_yes, sizeof(setsockopt_yes)) == -1)
+    {
+        fprintf(stderr, "[manager_init] Unable to set SO_REUSEPORT socket option\n");
+        close(listen_sock_fd);
+        return -1;
+    }
+
+    if (bind(listen_sock_fd, (struct sockaddr*) &(manager->listen_addr), sizeof(manager->listen_addr)) == -1)
     {
         fprintf(stderr, "[manager_init] Unable to bind\n");
-        return false;
+        close(listen_sock_fd);
+        return -1;
     }
 
     // Активируем очередь запросов на подключение.
-    if (listen(manager->listen_sock_fd, manager->num_nodes /* Размер очереди запросов на подключение */) == -1)
+    if (listen(listen_sock_fd, manager->num_nodes /* Размер очереди запросов на подключение */) == -1)
     {
         fprintf(stderr, "[manager_init] Unable to listen() on a socket\n");
+        close(listen_sock_fd);
+        return -1;
+    }
+    return listen_sock_fd;
+}
+
+static bool manager_init_socket(INFO_MANAGER* manager)
+{
+    if (manager->is_init == false) {
+        fprintf(stderr, "[manager_init] Not init Info Manager!\n");
         return false;
     }
-    return true;
+    manager->listen_sock_fd = manager_listen_socket(manager, manager->num_shards > 1);
+    return manager->listen_sock_fd != -1;
 }
 
-static bool manager_close_listen_socket(INFO_MANAGER* manager) {
+static bool manager_close_listen_socket(int listen_sock_fd) {
 
-    if (close(manager->listen_sock_fd) == -1)
+    if (close(listen_sock_fd) == -1)
     {
         fprintf(stderr, "[manager_close_listen_socket] Unable to close() listen-socket\n");
         return false;
@@ -137,12 +300,13 @@ static bool manager_close_listen_socket(INFO_MANAGER* manager) {
     return true;
 }
 
-static bool manager_accept_connection_request(INFO_MANAGER* manager, WORKER_CONN* conn)
+static bool manager_accept_connection_request(int listen_sock_fd, WORKER_CONN* conn)
 {
     DEBUG("Wait for worker_node to connect\n");
+    uint64_t trace_start = TRACE_START();
 
     // Создаём сокет для клиента из очереди на подключение.
-    conn->worker_sock_fd = accept(manager->listen_sock_fd, NULL, NULL);
+    conn->worker_sock_fd = accept(listen_sock_fd, NULL, NULL);
     if (conn->worker_sock_fd == -1)
     {
         fprintf(stderr, "[manager_accept_connection_request] Unable to accept() connection on a socket\n");
@@ -167,57 +331,194 @@ static bool manager_accept_connection_request(INFO_MANAGER* manager, WORKER_CONN
 
     DEBUG("Worker connected\n");
     conn->state = GET_INFO;
+    conn->in_flight = NULL;
+    conn->num_in_flight = 0;
+    conn->ans_buf = NULL;
+    conn->ans_cap = 0;
+    conn->clock_offset_ns = 0;
+    conn->clock_delay_ns = UINT64_MAX;
+    conn->metrics = NULL;
+    TRACE_SPAN("connect", trace_start);
     return true;
 }
 
 static bool manager_get_worker_info(WORKER_CONN *work)
 {
-    size_t bytes_read = recv(work->worker_sock_fd, &(work->n_cores), sizeof(work->n_cores), MSG_WAITALL);
-    if (bytes_read != sizeof(work->n_cores))
+    uint64_t trace_start = TRACE_START();
+    struct node_info info;
+    size_t bytes_read = recv(work->worker_sock_fd, &info, sizeof(info), MSG_WAITALL);
+    if (bytes_read != sizeof(info))
+    {
+        fprintf(stderr, "Unable to recv node info from worker: bytes_read=%lu\n", bytes_read);
+        return false;
+    }
+    work->n_cores = info.n_cores;
+    work->credits = info.credits == 0 ? 1 : info.credits > MANAGER_MAX_CREDITS ? MANAGER_MAX_CREDITS : info.credits;
+    work->in_flight = calloc(work->credits, sizeof(*work->in_flight));
+    if (!work->in_flight)
     {
-        fprintf(stderr, "Unable to recv n_cores info from worker: bytes_read=%d\n", bytes_read);
+        fprintf(stderr, "[manager_get_worker_info] Unable to allocate memory\n");
         return false;
     }
+    work->in_flight_head = 0;
+    work->num_in_flight = 0;
+    // Некорректные значения профиля считаются неизвестными.
+    for (int i = 0; i < NOT_SUPPORT; ++i) {
+        double evals_per_sec = info.evals_per_sec[i];
+        work->evals_per_sec[i] = isfinite(evals_per_sec) && evals_per_sec > 0 ? evals_per_sec : 0;
+    }
     work->state = WAIT_TASK;
-    DEBUG("Connect worker with cores : %lu\n",work->n_cores);
+    metrics_bytes_received(sizeof(info));
+    RECORD(RECORD_INFO, work->id, 0, info.n_cores, info.credits, sizeof(info));
+    DEBUG("Connect worker with cores : %d, credits: %u\n", work->n_cores, work->credits);
+    TRACE_SPAN("handshake", trace_start);
     return true;
 }
 
-static int manager_send_tasks(WORKER_CONN *work, size_t size_of_structure, char *data) 
+static int manager_send_tasks(WORKER_CONN *work, JOB_STATE *job, size_t task_i)
 {
+    uint64_t trace_start = TRACE_START();
+    size_t size_of_structure = job->job->size_of_structure;
+    char *data = job->job->tasks + task_i * size_of_structure;
+    struct in_flight_task *slot = &work->in_flight[(work->in_flight_head + work->num_in_flight) % work->credits];
+    slot->job = job;
+    slot->task_i = task_i;
+    slot->has_partial = false;
+    slot->sent_ns = trace_start ? trace_start : metrics_now_ns();
+    if (!slot->sent_ns && work->busy_poll)
+        slot->sent_ns = trace_now_ns();
 
-    size_t bytes_written = write(work->worker_sock_fd, data, size_of_structure);
+    size_t bytes_written = send(work->worker_sock_fd, data, size_of_structure, MSG_NOSIGNAL);
     if (bytes_written != size_of_structure)
     {
         fprintf(stderr, "Unable to send a task to worker\n");
         return -1;
     }
     DEBUG("Sent data with size: %lu\n", size_data);
+    work->num_in_flight++;
     work->state = WAIT_ANS;
+    metrics_task_sent(work->metrics, size_of_structure);
+    RECORD(RECORD_TASK, work->id, 0, 0, 0, size_of_structure);
+    TRACE_SPAN("send", trace_start);
     return 0;
 }
 
-static int manager_get_worker_ans(WORKER_CONN *work, char **ans) {
-    size_t ans_size = 0;
-    size_t bytes_read = recv(work->worker_sock_fd, &ans_size, sizeof(ans_size), MSG_WAITALL);
-    if (bytes_read != sizeof(ans_size))
+// Приём одного сообщения от рабочего узла.
+// Возвращает 1, если получен ответ (он записывается в ans_buf, размер - в ans_size, задержка обмена
+// в режиме низкой задержки - в latency_ns), 2, если узел вернул задачу по истечении своего max_time,
+// 0, если получено служебное сообщение, и -1 при ошибке.
+static int manager_get_worker_ans(WORKER_CONN *work, uint32_t pid, size_t *ans_size, uint64_t *latency_ns) {
+    uint64_t trace_start = TRACE_START();
+    struct msg_header header;
+    size_t bytes_read = recv(work->worker_sock_fd, &header, sizeof(header), MSG_WAITALL);
+    if (bytes_read != sizeof(header))
     {
-        fprintf(stderr, "can't get size: get %lu bytes from worker, expected %ld\n",bytes_read, sizeof(ans_size));
+        fprintf(stderr, "can't get size: get %lu bytes from worker, expected %ld\n",bytes_read, sizeof(header));
+        return -1;
+    }
+    metrics_bytes_received(sizeof(header) + header.size);
+    RECORD(RECORD_MESSAGE, work->id, header.type, header.compute_us, 0, header.size);
+
+    if (header.type == MSG_PARTIAL)
+    {
+        // Промежуточный результат относится к выполняемой, то есть самой ранней, задаче.
+        struct in_flight_task *task = &work->in_flight[work->in_flight_head];
+        if (header.size != sizeof(task->partial) ||
+                recv(work->worker_sock_fd, &task->partial, sizeof(task->partial), MSG_WAITALL) != sizeof(task->partial)) {
+            fprintf(stderr, "Unable to recv partial result from worker\n");
+            return -1;
+        }
+        task->has_partial = true;
         return 0;
     }
-    bytes_read = recv(work->worker_sock_fd, *ans, ans_size, MSG_WAITALL);
-    if (bytes_read != ans_size)
+    if (header.type == MSG_TRACE)
     {
-        fprintf(stderr, "Get %lu bytes from worker, expected %lu\n",bytes_read, ans_size);
+        // Размер проверяется до выделения памяти: его задаёт рабочий узел.
+        if (header.size < sizeof(struct trace_block) ||
+                header.size > sizeof(struct trace_block) + TRACE_MAX_EVENTS * sizeof(struct trace_event)) {
+            fprintf(stderr, "Wrong trace size %lu from worker\n", header.size);
+            return -1;
+        }
+        struct trace_block *block = malloc(header.size);
+        if (!block)
+            return -1;
+        bytes_read = recv(work->worker_sock_fd, block, header.size, MSG_WAITALL);
+        if (bytes_read != header.size ||
+                block->count > (header.size - sizeof(*block)) / sizeof(block->events[0])) {
+            fprintf(stderr, "Get %lu bytes of trace from worker, expected %lu\n", bytes_read, header.size);
+            free(block);
+            return -1;
+        }
+        uint64_t delay_ns;
+        int64_t offset_ns = trace_clock_offset(block, work->in_flight[work->in_flight_head].sent_ns,
+                trace_now_ns(), &delay_ns);
+        if (delay_ns < work->clock_delay_ns) {
+            work->clock_delay_ns = delay_ns;
+            work->clock_offset_ns = offset_ns;
+        }
+        trace_import(block, pid, work->clock_offset_ns);
+        free(block);
         return 0;
     }
-    printf("[manager_get_worker_ans] got %lf\n", **(double **)ans);
-    return bytes_read;
+    if (header.type == MSG_EXPIRED)
+    {
+        // Задача снимается с узла без ответа; в очередь её возвращает вызывающий.
+        if (header.size)
+            return -1;
+        work->in_flight_head = (work->in_flight_head + 1) % work->credits;
+        work->num_in_flight--;
+        return 2;
+    }
+    if (header.type != MSG_ANSWER)
+    {
+        fprintf(stderr, "Unexpected message type %u from worker\n", header.type);
+        return -1;
+    }
+    // Ответ больше области ответов задания не принимается: узел неисправен или собран иначе.
+    if (header.size > work->in_flight[work->in_flight_head].job->job->ans_capacity)
+    {
+        fprintf(stderr, "Answer of %lu bytes exceeds the job answer area\n", header.size);
+        return -1;
+    }
+
+    if (header.size > work->ans_cap)
+    {
+        char *ans_buf = realloc(work->ans_buf, header.size);
+        if (!ans_buf) {
+            fprintf(stderr, "[manager_get_worker_ans] Unable to allocate memory\n");
+            return -1;
+        }
+        work->ans_buf = ans_buf;
+        work->ans_cap = header.size;
+    }
+    bytes_read = recv(work->worker_sock_fd, work->ans_buf, header.size, MSG_WAITALL);
+    if (bytes_read != header.size)
+    {
+        fprintf(stderr, "Get %lu bytes from worker, expected %lu\n",bytes_read, header.size);
+        return -1;
+    }
+    // Формат ответа знает только задание: в журнал попадает лишь размер.
+    LOG_DEBUG("[manager_get_worker_ans] got %lu bytes", header.size);
+    *ans_size = bytes_read;
+    // Ответ относится к самой ранней выданной задаче.
+    uint64_t sent_ns = work->in_flight[work->in_flight_head].sent_ns;
+    metrics_task_done(work->metrics, sent_ns, header.compute_us);
+    if (work->busy_poll) {
+        uint64_t rtt_ns = trace_now_ns() - sent_ns;
+        uint64_t compute_ns = (uint64_t)header.compute_us * 1000;
+        *latency_ns = rtt_ns > compute_ns ? rtt_ns - compute_ns : 0;
+    }
+    work->in_flight_head = (work->in_flight_head + 1) % work->credits;
+    work->num_in_flight--;
+    TRACE_SPAN("recv_answer", trace_start);
+    return 1;
 }
 
-static bool manager_close_worker_socket(WORKER_CONN *work) {
-    size_t end_tasks = 0;
-    write(work->worker_sock_fd,&end_tasks,sizeof(end_tasks));
+// Закрытие соединения; при отмене задания узел прерывает выполняемые задачи.
+static bool manager_close_worker_socket(WORKER_CONN *work, bool cancel) {
+    size_t end_tasks = cancel ? TASK_SIZE_CANCEL : TASK_SIZE_END;
+    send(work->worker_sock_fd, &end_tasks, sizeof(end_tasks), MSG_NOSIGNAL);
+    RECORD(RECORD_CLOSE, work->id, 0, cancel, 0, 0);
     if (close(work->worker_sock_fd) == -1)
     {
         fprintf(stderr, "[manager_close_worker_socket] Unable to close() worker-socket\n");
@@ -227,179 +528,1073 @@ static bool manager_close_worker_socket(WORKER_CONN *work) {
     return true;
 }
 
-static bool wait_and_get_info_workers(INFO_MANAGER* manager, WORKER_CONN *works, struct pollfd *pollfds) {
-    size_t num_connected_workers = 0U;
-    size_t num_init_workers = 0U;
-    fprintf(stderr, "[wait_and_get_info_workers] Waiting workers\n");
-    while (num_init_workers != manager->num_nodes)
-    {
-        if (num_connected_workers != manager->num_nodes) {
-            poll_server_wait_for_worker(pollfds, manager);
-        } else {
-            poll_server_do_not_wait_for_workers(pollfds);
+static void job_requeue(JOB_STATE *job, size_t task_i)
+{
+    job->requeued[job->num_requeued++] = task_i;
+}
+
+// Учёт узла, передавшего данные о себе (sign = 1) или отключившегося (sign = -1), в ресурсах
+// для планирования; вызывается под блокировкой списка заданий.
+static void loop_cluster_update(MANAGER_LOOP *loop, const WORKER_CONN *work, int sign)
+{
+    MANAGER_CLUSTER *cluster = &loop->cluster;
+    bool profiled = false;
+    for (int i = 0; i < NOT_SUPPORT; ++i) {
+        cluster->evals_per_sec[i] += sign * work->evals_per_sec[i] * work->n_cores;
+        profiled |= work->evals_per_sec[i] > 0;
+    }
+    cluster->num_nodes += sign;
+    cluster->num_cores += sign * work->n_cores;
+    if (profiled)
+        cluster->profiled_cores += sign * work->n_cores;
+}
+
+static void manager_drop_worker(MANAGER_SHARD *shard, size_t conn_i)
+{
+    WORKER_CONN *work = &shard->works[conn_i];
+    RECORD(RECORD_DISCONNECT, work->id, 0, 0, 0, 0);
+    // Незавершённые задачи отключившегося узла достанутся другим узлам.
+    pthread_mutex_lock(&shard->loop->lock);
+    for (uint32_t i = 0; i < work->num_in_flight; ++i) {
+        struct in_flight_task *task = &work->in_flight[(work->in_flight_head + i) % work->credits];
+        job_requeue(task->job, task->task_i);
+    }
+    if (work->state == WAIT_TASK || work->state == WAIT_ANS)
+        loop_cluster_update(shard->loop, work, -1);
+    pthread_mutex_unlock(&shard->loop->lock);
+    if (work->state == WAIT_TASK || work->state == WAIT_ANS)
+        metrics_worker_down(work->metrics, work->num_in_flight);
+    work->num_in_flight = 0;
+    free(work->in_flight);
+    work->in_flight = NULL;
+    free(work->ans_buf);
+    work->ans_buf = NULL;
+    work->ans_cap = 0;
+    if (work->worker_sock_fd >= 0 && close(work->worker_sock_fd) == -1) {
+        fprintf(stderr, "[manager_drop_worker] Unable to close() worker-socket\n");
+    }
+    work->worker_sock_fd = -1;
+    work->state = WORK_FINISHED;
+    poll_manager_do_not_wait_for_ans(shard->pollfds, conn_i);
+}
+
+static bool job_has_tasks(const JOB_STATE *job)
+{
+    return job->num_requeued || job->next_task < job->job->num_tasks;
+}
+
+static size_t job_pop(JOB_STATE *job)
+{
+    if (job->num_requeued)
+        return job->requeued[--job->num_requeued];
+    return job->next_task++;
+}
+
+// Выбор задания для очередного кредита узла с num_in_flight выданными задачами: строгий
+// приоритет, внутри приоритета - наименьшее виртуальное время. Вытесняемые задания получает
+// только свободный узел.
+static JOB_STATE *sched_pick(JOB_LIST *jobs, uint32_t num_in_flight)
+{
+    JOB_STATE *best = NULL;
+    bool found = false;
+    int priority = 0;
+
+    for (size_t i = 0; i < jobs->num_jobs; ++i) {
+        if (!job_has_tasks(jobs->jobs[i]))
+            continue;
+        if (!found || jobs->jobs[i]->job->priority > priority)
+            priority = jobs->jobs[i]->job->priority;
+        found = true;
+    }
+    for (size_t i = 0; i < jobs->num_jobs; ++i) {
+        JOB_STATE *job = jobs->jobs[i];
+        if (!job_has_tasks(job) || job->job->priority != priority)
+            continue;
+        if (job->job->preemptible && num_in_flight)
+            continue;
+        if (!best || job->vtime < best->vtime)
+            best = job;
+    }
+    return best;
+}
+
+// Выдача рабочему узлу задач до исчерпания его кредитов; узел без выданных задач
+// остаётся в WAIT_TASK. Задачи выбираются под блокировкой списка заданий одним проходом,
+// а отправляются уже без неё.
+static void manager_dispatch(MANAGER_SHARD *shard, size_t conn_i)
+{
+    MANAGER_LOOP *loop = shard->loop;
+    WORKER_CONN *work = &shard->works[conn_i];
+    struct {
+        JOB_STATE *job;
+        size_t task_i;
+    } picked[MANAGER_MAX_CREDITS];
+    uint32_t num_picked = 0;
+    JOB_STATE *job;
+
+    pthread_mutex_lock(&loop->lock);
+    while (work->num_in_flight + num_picked < work->credits &&
+            (job = sched_pick(&loop->jobs, work->num_in_flight + num_picked))) {
+        picked[num_picked].job = job;
+        picked[num_picked++].task_i = job_pop(job);
+        loop->jobs.vtime = job->vtime;
+        job->vtime += 1.0 / job->job->weight;
+    }
+    pthread_mutex_unlock(&loop->lock);
+
+    for (uint32_t i = 0; i < num_picked; ++i) {
+        if (manager_send_tasks(work, picked[i].job, picked[i].task_i)) {
+            // Неотправленные задачи ещё не записаны в очередь узла.
+            pthread_mutex_lock(&loop->lock);
+            for (; i < num_picked; ++i)
+                job_requeue(picked[i].job, picked[i].task_i);
+            pthread_mutex_unlock(&loop->lock);
+            manager_drop_worker(shard, conn_i);
+            return;
         }
-        int pollret = poll(pollfds, 1U + num_connected_workers, -1);
-        if (pollret == -1)
-        {
-            fprintf(stderr, "Unable to poll-wait for data on descriptors!\n");
-            goto error;
+    }
+    work->state = work->num_in_flight ? WAIT_ANS : WAIT_TASK;
+    poll_manager_wait_for_answer(shard->pollfds, conn_i, work);
+}
+
+static bool manager_reserve_conns(WORKER_CONN **works, struct pollfd **pollfds, size_t *capacity, size_t needed)
+{
+    if (needed <= *capacity)
+        return true;
+
+    size_t new_capacity = *capacity * 2 > needed ? *capacity * 2 : needed;
+    WORKER_CONN *new_works = realloc(*works, new_capacity * sizeof(**works));
+    if (!new_works)
+        return false;
+    *works = new_works;
+
+    struct pollfd *new_pollfds = realloc(*pollfds, (new_capacity + POLL_CONNS) * sizeof(**pollfds));
+    if (!new_pollfds)
+        return false;
+    *pollfds = new_pollfds;
+
+    *capacity = new_capacity;
+    return true;
+}
+
+static int64_t manager_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//============================
+// Планировщик заданий
+//============================
+
+static void manager_sched_wake(MANAGER_SCHED *sched)
+{
+    uint64_t one = 1;
+    if (write(sched->wake_fd, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr, "[manager_sched_wake] Unable to write() wakeup counter\n");
+}
+
+static void job_finish(MANAGER_SCHED *sched, MANAGER_JOB *job, int status)
+{
+    pthread_mutex_lock(&sched->lock);
+    job->status = status;
+    job->done = true;
+    pthread_cond_broadcast(&sched->done);
+    pthread_mutex_unlock(&sched->lock);
+}
+
+static void job_state_free(JOB_STATE *state)
+{
+    free(state->requeued);
+    free(state);
+}
+
+// Планирование задания по подключённым узлам и подготовка очереди возврата задач; задание
+// без функции планирования только получает очередь. Возвращает false, если задание отклонено
+// или не хватило памяти.
+static bool sched_plan_job(MANAGER_LOOP *loop, JOB_STATE *state)
+{
+    MANAGER_JOB *job = state->job;
+    if (job->plan) {
+        pthread_mutex_lock(&loop->lock);
+        MANAGER_CLUSTER cluster = loop->cluster;
+        pthread_mutex_unlock(&loop->lock);
+        int64_t left_ms = loop->deadline_ms - manager_now_ms();
+        cluster.time_left = left_ms > 0 ? left_ms / 1e3 : 0;
+        if (job->plan(job, &cluster)) {
+            LOG_INFO("[start_manager] Job rejected by planner");
+            return false;
+        }
+        if (!job->tasks || !job->ans || !job->ans_capacity || !job->size_of_structure || !job->num_tasks) {
+            fprintf(stderr, "[sched_plan_job] Planned job has no tasks\n");
+            return false;
         }
+    }
+    state->requeued = calloc(job->num_tasks, sizeof(size_t));
+    if (!state->requeued) {
+        fprintf(stderr, "[sched_plan_job] Unable to allocate memory\n");
+        return false;
+    }
+    return true;
+}
 
-        if (pollfds[0U].revents & POLLIN)
-        {
-            if(!manager_accept_connection_request(manager, &works[num_connected_workers])){
-                goto error;
-            }
+// Приём поданных заданий в список активных; возвращает true, если новых заданий не будет.
+// Задания с функцией планирования, поданные до старта, планируются при старте (sched_plan_jobs).
+static bool sched_accept_jobs(MANAGER_SCHED *sched, MANAGER_LOOP *loop, size_t *num_accepted)
+{
+    JOB_LIST *jobs = &loop->jobs;
+    uint64_t counter;
+    if (read(sched->wake_fd, &counter, sizeof(counter)) == -1 && errno != EAGAIN)
+        fprintf(stderr, "[sched_accept_jobs] Unable to read() wakeup counter\n");
 
-            poll_manager_wait_work_info(pollfds, num_connected_workers, &works[num_connected_workers]);
-            num_connected_workers++;
-        } 
+    pthread_mutex_lock(&sched->lock);
+    bool closed = sched->closed;
+    MANAGER_JOB **submitted = sched->submitted;
+    size_t num_submitted = sched->num_submitted;
+    sched->submitted = NULL;
+    sched->num_submitted = 0;
+    sched->cap_submitted = 0;
+    pthread_mutex_unlock(&sched->lock);
 
-        for (size_t conn_i = 0U; conn_i < num_connected_workers; ++conn_i)
-        {
-            if (pollfds[1U + conn_i].revents & POLLHUP)
-            {  
-                fprintf(stderr, "Unexpected POLLHUP\n");
-                goto error;
+    *num_accepted = 0;
+    for (size_t i = 0; i < num_submitted; ++i) {
+        MANAGER_JOB *job = submitted[i];
+        JOB_STATE *state = calloc(1, sizeof(*state));
+        if (state)
+            state->job = job;
+        if (state && (!job->plan || atomic_load(&loop->started)) && !sched_plan_job(loop, state)) {
+            job_state_free(state);
+            job_finish(sched, job, -1);
+            continue;
+        }
+        bool added = false;
+        pthread_mutex_lock(&loop->lock);
+        if (jobs->num_jobs == jobs->capacity) {
+            size_t capacity = jobs->capacity ? 2 * jobs->capacity : 8;
+            JOB_STATE **list = realloc(jobs->jobs, capacity * sizeof(*list));
+            if (list) {
+                jobs->jobs = list;
+                jobs->capacity = capacity;
             }
+        }
+        if (state && jobs->num_jobs < jobs->capacity) {
+            // Новое задание встаёт в справедливую очередь с текущего виртуального времени.
+            state->vtime = jobs->vtime;
+            jobs->jobs[jobs->num_jobs++] = state;
+            added = true;
+        }
+        pthread_mutex_unlock(&loop->lock);
+        if (!added) {
+            fprintf(stderr, "[sched_accept_jobs] Unable to allocate memory\n");
+            if (state)
+                job_state_free(state);
+            job_finish(sched, job, -1);
+            continue;
+        }
+        ++*num_accepted;
+    }
+    free(submitted);
+    return closed;
+}
+
+// Планирование при старте заданий, принятых до набора кворума; отклонённые задания
+// завершаются с ошибкой. Другие циклы в это время ещё не выдают задачи.
+static void sched_plan_jobs(MANAGER_SCHED *sched, MANAGER_LOOP *loop)
+{
+    JOB_LIST *jobs = &loop->jobs;
+    for (size_t i = 0; i < jobs->num_jobs; ) {
+        JOB_STATE *state = jobs->jobs[i];
+        if (state->requeued || sched_plan_job(loop, state)) {
+            ++i;
+            continue;
+        }
+        pthread_mutex_lock(&loop->lock);
+        memmove(&jobs->jobs[i], &jobs->jobs[i + 1], (jobs->num_jobs - i - 1) * sizeof(*jobs->jobs));
+        jobs->num_jobs--;
+        pthread_mutex_unlock(&loop->lock);
+        job_finish(sched, state->job, -1);
+        job_state_free(state);
+    }
+}
+
+// Есть ли поданные, но ещё не принятые задания.
+static bool sched_has_submitted(MANAGER_SCHED *sched)
+{
+    pthread_mutex_lock(&sched->lock);
+    bool submitted = sched->num_submitted != 0;
+    pthread_mutex_unlock(&sched->lock);
+    return submitted;
+}
+
+static size_t sched_num_jobs(MANAGER_LOOP *loop)
+{
+    pthread_mutex_lock(&loop->lock);
+    size_t num_jobs = loop->jobs.num_jobs;
+    pthread_mutex_unlock(&loop->lock);
+    return num_jobs;
+}
+
+static void atomic_add_double(_Atomic double *sum, double value)
+{
+    double old = atomic_load_explicit(sum, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(sum, &old, old + value,
+                memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+// Учёт ответа без блокировки: место в области ответов резервируется атомарно, поэтому ответы
+// из разных циклов записываются подряд в порядке получения. Полностью выполненное задание
+// убирается из списка активных. Возвращает false, если ответ не помещается в область ответов.
+static bool sched_job_answered(MANAGER_SHARD *shard, JOB_STATE *state, const char *ans, size_t ans_size)
+{
+    MANAGER_LOOP *loop = shard->loop;
+    size_t offset = atomic_load_explicit(&state->ans_used, memory_order_relaxed);
+    do {
+        if (ans_size > state->job->ans_capacity - offset) {
+            fprintf(stderr, "[sched_job_answered] Answer area of the job is full\n");
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&state->ans_used, &offset, offset + ans_size,
+                memory_order_relaxed, memory_order_relaxed));
+    memcpy(state->job->ans + offset, ans, ans_size);
+    if (state->job->estimate && ans_size >= sizeof(double)) {
+        double value;
+        memcpy(&value, ans, sizeof(value));
+        atomic_add_double(&state->answered, value);
+        atomic_add_double(&state->answered_sq, value * value);
+    }
+    // Последний ответ видит ответы и сумму, записанные другими циклами.
+    if (atomic_fetch_add_explicit(&state->num_answers, 1, memory_order_acq_rel) + 1 != state->job->num_tasks)
+        return true;
+    if (state->job->estimate)
+        *state->job->estimate = (MANAGER_ESTIMATE){
+            .value = atomic_load_explicit(&state->answered, memory_order_relaxed), .error = 0, .coverage = 1 };
+
+    pthread_mutex_lock(&loop->lock);
+    JOB_LIST *jobs = &loop->jobs;
+    for (size_t i = 0; i < jobs->num_jobs; ++i) {
+        if (jobs->jobs[i] == state) {
+            memmove(&jobs->jobs[i], &jobs->jobs[i + 1], (jobs->num_jobs - i - 1) * sizeof(*jobs->jobs));
+            jobs->num_jobs--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&loop->lock);
+    job_finish(loop->sched, state->job, 0);
+    job_state_free(state);
+    // Завершение работы определяет первый цикл.
+    if (shard != loop->shards)
+        manager_sched_wake(loop->sched);
+    return true;
+}
+
+MANAGER_SCHED *manager_sched_create(void)
+{
+    MANAGER_SCHED *sched = calloc(1, sizeof(*sched));
+    if (!sched)
+        return NULL;
+    sched->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (sched->wake_fd == -1) {
+        fprintf(stderr, "[manager_sched_create] Unable to create eventfd\n");
+        free(sched);
+        return NULL;
+    }
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->done, NULL);
+    return sched;
+}
+
+int manager_sched_submit(MANAGER_SCHED *sched, MANAGER_JOB *job)
+{
+    if (!sched || !job)
+        return -1;
+    if (!job->plan && (!job->tasks || !job->ans || !job->ans_capacity || !job->size_of_structure || !job->num_tasks))
+        return -1;
+    if (!(job->weight > 0))
+        job->weight = 1;
+
+    pthread_mutex_lock(&sched->lock);
+    if (sched->closed) {
+        pthread_mutex_unlock(&sched->lock);
+        return -1;
+    }
+    job->status = 0;
+    job->done = false;
+    if (sched->num_submitted == sched->cap_submitted) {
+        size_t capacity = sched->cap_submitted ? 2 * sched->cap_submitted : 8;
+        MANAGER_JOB **submitted = realloc(sched->submitted, capacity * sizeof(*submitted));
+        if (!submitted) {
+            pthread_mutex_unlock(&sched->lock);
+            return -1;
+        }
+        sched->submitted = submitted;
+        sched->cap_submitted = capacity;
+    }
+    sched->submitted[sched->num_submitted++] = job;
+    pthread_mutex_unlock(&sched->lock);
 
-            if (pollfds[1U + conn_i].revents & POLLIN)
-            {
-                switch (works[conn_i].state)
-                {
-                case CONNECTION_EMPTY:
-                case WORK_FINISHED:
-                case WAIT_ANS:
-                    fprintf(stderr, "Unexpected state!\n");
-                    goto error;
-                case GET_INFO:
-                    if(!manager_get_worker_info(&works[conn_i])) {
-                        goto error;
-                    }
-                    num_init_workers++;
-                    break;
-                case WAIT_TASK:
+    manager_sched_wake(sched);
+    return 0;
+}
+
+int manager_sched_wait(MANAGER_SCHED *sched, MANAGER_JOB *job)
+{
+    pthread_mutex_lock(&sched->lock);
+    while (!job->done)
+        pthread_cond_wait(&sched->done, &sched->lock);
+    int status = job->status;
+    pthread_mutex_unlock(&sched->lock);
+    return status;
+}
+
+void manager_sched_close(MANAGER_SCHED *sched)
+{
+    pthread_mutex_lock(&sched->lock);
+    sched->closed = true;
+    pthread_mutex_unlock(&sched->lock);
+    manager_sched_wake(sched);
+}
+
+void manager_sched_destroy(MANAGER_SCHED *sched)
+{
+    if (!sched)
+        return;
+    close(sched->wake_fd);
+    pthread_mutex_destroy(&sched->lock);
+    pthread_cond_destroy(&sched->done);
+    free(sched->submitted);
+    free(sched);
+}
+
+// Завершение с ошибкой всех невыполненных заданий (в том числе ещё не принятых).
+static void sched_fail_all(MANAGER_SCHED *sched, JOB_LIST *jobs)
+{
+    for (size_t i = 0; i < jobs->num_jobs; ++i) {
+        job_finish(sched, jobs->jobs[i]->job, -1);
+        job_state_free(jobs->jobs[i]);
+    }
+    jobs->num_jobs = 0;
+
+    pthread_mutex_lock(&sched->lock);
+    sched->closed = true;
+    for (size_t i = 0; i < sched->num_submitted; ++i) {
+        sched->submitted[i]->status = -1;
+        sched->submitted[i]->done = true;
+    }
+    sched->num_submitted = 0;
+    pthread_cond_broadcast(&sched->done);
+    pthread_mutex_unlock(&sched->lock);
+}
+
+// Завершение по истечении времени заданий, для которых запрошена оценка: к полученным ответам
+// добавляются последние промежуточные результаты выполняемых задач, а задачи без данных
+// (невыданные и ждущие в очереди узлов) экстраполируются по задачам с данными. Вызывается
+// после остановки всех циклов.
+static void sched_estimate_jobs(MANAGER_SCHED *sched, MANAGER_LOOP *loop)
+{
+    JOB_LIST *jobs = &loop->jobs;
+    for (size_t i = 0; i < jobs->num_jobs; ) {
+        JOB_STATE *state = jobs->jobs[i];
+        if (!state->job->estimate) {
+            ++i;
+            continue;
+        }
+
+        // Полученные ответы точны и входят с весом 1, промежуточные результаты - с весом
+        // выполненной доли задачи; по весам считаются среднее и разброс результата задачи.
+        size_t num_answers = atomic_load(&state->num_answers);
+        size_t estimated = num_answers;
+        double answered = atomic_load(&state->answered);
+        MANAGER_ESTIMATE estimate = { .value = answered, .error = 0, .coverage = num_answers };
+        double weight = num_answers;
+        double weighted = answered;
+        double weighted_sq = atomic_load(&state->answered_sq);
+        for (size_t shard_i = 0; shard_i < loop->num_shards; ++shard_i) {
+            MANAGER_SHARD *shard = &loop->shards[shard_i];
+            for (size_t conn_i = 0; conn_i < shard->num_conns; ++conn_i) {
+                WORKER_CONN *work = &shard->works[conn_i];
+                for (uint32_t t = 0; t < work->num_in_flight; ++t) {
+                    struct in_flight_task *task = &work->in_flight[(work->in_flight_head + t) % work->credits];
+                    if (task->job != state || !task->has_partial)
+                        continue;
+                    double value = task->partial.value;
+                    double coverage = task->partial.coverage;
+                    estimate.value += value;
+                    estimate.error += task->partial.error;
+                    estimate.coverage += coverage;
+                    weight += coverage;
+                    weighted += coverage * value;
+                    weighted_sq += coverage * value * value;
+                    ++estimated;
                 }
             }
         }
+
+        // Задачи без данных считаются однородными с остальными: каждая получает среднее,
+        // а к погрешности добавляется интервал предсказания суммы missing задач (их собственный
+        // разброс и погрешность самого среднего) по распределению Стьюдента, так как задач
+        // с данными обычно мало. Разброс берётся относительно нуля, а не среднего: случайно
+        // близкие значения немногих задач не сужают интервал, и он всегда накрывает
+        // экстраполированную часть целиком.
+        size_t missing = state->job->num_tasks - estimated;
+        if (missing && weight > 0) {
+            double mean = weighted / weight;
+            double spread = sqrt(weighted_sq / weight);
+            double t = mc_t_quantile(MANAGER_ESTIMATE_Z, estimated > 1 ? estimated - 1 : 1);
+            estimate.value += missing * mean;
+            estimate.error += t * spread * sqrt(missing * (1 + (double)missing / estimated));
+        } else if (missing) {
+            // Данных нет ни по одной задаче.
+            estimate.error = INFINITY;
+        }
+        estimate.coverage /= state->job->num_tasks;
+        *state->job->estimate = estimate;
+
+        memmove(&jobs->jobs[i], &jobs->jobs[i + 1], (jobs->num_jobs - i - 1) * sizeof(*jobs->jobs));
+        jobs->num_jobs--;
+        job_finish(sched, state->job, 1);
+        job_state_free(state);
+    }
+}
+
+//============================
+// Циклы обработки соединений
+//============================
+
+static bool shard_init(MANAGER_SHARD *shard, size_t capacity)
+{
+    shard->capacity = capacity;
+    shard->works = calloc(capacity, sizeof(WORKER_CONN));
+    shard->pollfds = calloc(capacity + POLL_CONNS, sizeof(struct pollfd));
+    if (!shard->works || !shard->pollfds)
+        return false;
+    // Слушающий сокет открыт всё время работы: опоздавшие узлы получают невыданные задачи.
+    poll_server_wait_for_worker(shard->pollfds, shard->listen_sock_fd);
+    poll_manager_wait_for_wakeup(shard->pollfds, shard->wake_fd);
+    return true;
+}
+
+// Пробуждение циклов в отдельных потоках: запуск вычисления, новые задания или остановка.
+static void loop_wake_shards(MANAGER_LOOP *loop)
+{
+    uint64_t one = 1;
+    for (size_t i = 1; i < loop->num_shards; ++i) {
+        if (write(loop->shards[i].wake_fd, &one, sizeof(one)) != sizeof(one))
+            fprintf(stderr, "[loop_wake_shards] Unable to write() wakeup counter\n");
+    }
+}
+
+// Выдача задач всем узлам цикла со свободными кредитами.
+static void shard_dispatch_all(MANAGER_SHARD *shard)
+{
+    for (size_t conn_i = 0; conn_i < shard->num_conns; ++conn_i) {
+        if (shard->works[conn_i].state == WAIT_TASK || shard->works[conn_i].state == WAIT_ANS) {
+            manager_dispatch(shard, conn_i);
+        }
+    }
+}
+
+static bool shard_accept(MANAGER_SHARD *shard)
+{
+    if (!manager_reserve_conns(&shard->works, &shard->pollfds, &shard->capacity, shard->num_conns + 1)) {
+        fprintf(stderr, "[start_manager] Unable to allocate memory\n");
+        return false;
+    }
+    WORKER_CONN *work = &shard->works[shard->num_conns];
+    work->state = CONNECTION_EMPTY;
+    if (manager_accept_connection_request(shard->listen_sock_fd, work)) {
+        work->id = atomic_fetch_add_explicit(&shard->loop->next_conn_id, 1, memory_order_relaxed);
+        int busy_poll_us = shard->loop->manager->busy_poll_us;
+        work->busy_poll = busy_poll_us != 0;
+        // Ядро опрашивает очередь сетевой карты при чтении вместо ожидания прерывания
+        // (значение выше net.core.busy_read требует CAP_NET_ADMIN).
+        if (work->busy_poll && setsockopt(work->worker_sock_fd, SOL_SOCKET, SO_BUSY_POLL,
+                    &busy_poll_us, sizeof(busy_poll_us)) == -1)
+            LOG_WARN("[start_manager] Unable to set SO_BUSY_POLL: %s", strerror(errno));
+        RECORD(RECORD_CONNECT, work->id, 0, 0, 0, 0);
+        poll_manager_wait_work_info(shard->pollfds, shard->num_conns, work);
+        shard->num_conns++;
+    } else if (work->worker_sock_fd >= 0) {
+        close(work->worker_sock_fd);
+    }
+    return true;
+}
+
+static void shard_record_latency(MANAGER_SHARD *shard, uint64_t latency_ns)
+{
+    if (shard->num_latencies == shard->cap_latencies) {
+        size_t capacity = shard->cap_latencies ? 2 * shard->cap_latencies : 1024;
+        uint64_t *latencies = realloc(shard->latencies, capacity * sizeof(*latencies));
+        if (!latencies)
+            return;
+        shard->latencies = latencies;
+        shard->cap_latencies = capacity;
+    }
+    shard->latencies[shard->num_latencies++] = latency_ns;
+}
+
+// Ожидание событий цикла. В режиме низкой задержки дескрипторы сначала опрашиваются без сна
+// (poll с нулевым таймаутом) не дольше busy_poll_us, и только затем цикл засыпает в poll.
+static int shard_poll(MANAGER_SHARD *shard, int timeout_ms)
+{
+    uint32_t busy_poll_us = shard->loop->manager->busy_poll_us;
+    nfds_t nfds = POLL_CONNS + shard->num_conns;
+    if (busy_poll_us && timeout_ms) {
+        uint64_t deadline_ns = trace_now_ns() + (uint64_t)busy_poll_us * 1000;
+        do {
+            int ret = poll(shard->pollfds, nfds, 0);
+            if (ret)
+                return ret;
+        } while (trace_now_ns() < deadline_ns);
+    }
+    return poll(shard->pollfds, nfds, timeout_ms);
+}
+
+// Закрепление потока цикла за ядром в режиме низкой задержки: циклы занимают ядра с последнего,
+// чтобы не пересекаться с потоками вычисления рабочего узла на той же машине (они занимают ядра с нулевого).
+static void shard_pin(size_t shard_i)
+{
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus <= 0)
+        return;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(num_cpus - 1 - shard_i % num_cpus, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset))
+        LOG_WARN("[start_manager] Unable to pin loop %lu", shard_i);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Сводка задержек обмена всех циклов после их остановки.
+static void loop_report_latency(MANAGER_LOOP *loop)
+{
+    MANAGER_LATENCY *latency = &loop->manager->latency;
+    size_t count = 0;
+    *latency = (MANAGER_LATENCY){};
+    for (size_t i = 0; i < loop->num_shards; ++i)
+        count += loop->shards[i].num_latencies;
+    uint64_t *all = count ? malloc(count * sizeof(*all)) : NULL;
+    if (!all)
+        return;
+    count = 0;
+    for (size_t i = 0; i < loop->num_shards; ++i) {
+        memcpy(all + count, loop->shards[i].latencies, loop->shards[i].num_latencies * sizeof(*all));
+        count += loop->shards[i].num_latencies;
+    }
+    qsort(all, count, sizeof(*all), cmp_u64);
+    latency->count = count;
+    latency->p50_ns = all[(count - 1) / 2];
+    latency->p99_ns = all[(size_t)ceil(0.99 * count) - 1];
+    latency->max_ns = all[count - 1];
+    free(all);
+}
+
+// Обработка событий соединений цикла после poll; false при внутренней ошибке.
+static bool shard_handle_conns(MANAGER_SHARD *shard)
+{
+    MANAGER_LOOP *loop = shard->loop;
+    for (size_t conn_i = 0U; conn_i < shard->num_conns; ++conn_i)
+    {
+        WORKER_CONN *work = &shard->works[conn_i];
+        short revents = shard->pollfds[POLL_CONNS + conn_i].revents;
+        if (!revents)
+            continue;
+
+        if (!(revents & POLLIN))
+        {
+            fprintf(stderr, "[start_manager] Worker disconnected\n");
+            if (work->state != GET_INFO)
+                atomic_fetch_sub(&loop->num_init_workers, 1);
+            manager_drop_worker(shard, conn_i);
+            continue;
+        }
+
+        size_t ans_size = 0;
+        uint64_t latency_ns = 0;
+        JOB_STATE *job;
+        size_t task_i;
+        bool started;
+        int ret;
+        switch (work->state)
+        {
+        case CONNECTION_EMPTY:
+        case WORK_FINISHED:
+            fprintf(stderr, "Unexpected state!\n");
+            return false;
+        case GET_INFO:
+            if (!manager_get_worker_info(work)) {
+                manager_drop_worker(shard, conn_i);
+                break;
+            }
+            pthread_mutex_lock(&loop->lock);
+            loop_cluster_update(loop, work, 1);
+            pthread_mutex_unlock(&loop->lock);
+            atomic_fetch_add(&loop->num_init_workers, 1);
+            started = atomic_load(&loop->started);
+            work->metrics = metrics_worker_up(work->id, work->n_cores, started);
+            if (started) {
+                manager_dispatch(shard, conn_i);
+            } else if (shard != loop->shards) {
+                // Кворум проверяет первый цикл.
+                manager_sched_wake(loop->sched);
+            }
+            break;
+        case WAIT_ANS:
+            // Ответ относится к самой ранней выданной узлу задаче.
+            job = work->in_flight[work->in_flight_head].job;
+            task_i = work->in_flight[work->in_flight_head].task_i;
+            if ((ret = manager_get_worker_ans(work, work->id + 1, &ans_size, &latency_ns)) < 0) {
+                atomic_fetch_sub(&loop->num_init_workers, 1);
+                manager_drop_worker(shard, conn_i);
+                break;
+            }
+            if (ret == 0)
+                break;
+            if (ret == 2) {
+                // Узел не успел выполнить задачу за свой max_time, но остаётся в работе.
+                LOG_WARN("[start_manager] Worker %u returned an expired task", work->id);
+                pthread_mutex_lock(&loop->lock);
+                job_requeue(job, task_i);
+                pthread_mutex_unlock(&loop->lock);
+                manager_dispatch(shard, conn_i);
+                break;
+            }
+            LOG_DEBUG("[start_manager] got an answer");
+            if (work->busy_poll)
+                shard_record_latency(shard, latency_ns);
+            if (!sched_job_answered(shard, job, work->ans_buf, ans_size)) {
+                // Задача уже снята с узла: она возвращается в очередь вместе с остальными.
+                pthread_mutex_lock(&loop->lock);
+                job_requeue(job, task_i);
+                pthread_mutex_unlock(&loop->lock);
+                atomic_fetch_sub(&loop->num_init_workers, 1);
+                manager_drop_worker(shard, conn_i);
+                break;
+            }
+            manager_dispatch(shard, conn_i);
+            break;
+        case WAIT_TASK:
+            // Свободный узел ничего не присылает: это закрытие соединения.
+            fprintf(stderr, "[start_manager] Worker disconnected\n");
+            atomic_fetch_sub(&loop->num_init_workers, 1);
+            manager_drop_worker(shard, conn_i);
+            break;
+        }
     }
-    fprintf(stderr, "[wait_and_get_info_workers] Waiting workers finished\n");
     return true;
+}
+
+// Цикл в отдельном потоке: только свои соединения; работает до остановки первым циклом.
+static void *shard_thread(void *arg)
+{
+    MANAGER_SHARD *shard = arg;
+    MANAGER_LOOP *loop = shard->loop;
+
+    if (loop->manager->busy_poll_us)
+        shard_pin(shard - loop->shards);
+    while (!atomic_load(&loop->stop)) {
+        int pollret = shard_poll(shard, -1);
+        if (pollret == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Unable to poll-wait for data on descriptors!\n");
+            goto error;
+        }
+
+        if (shard->pollfds[POLL_WAKEUP].revents & POLLIN)
+        {
+            uint64_t counter;
+            if (read(shard->wake_fd, &counter, sizeof(counter)) == -1 && errno != EAGAIN)
+                fprintf(stderr, "[shard_thread] Unable to read() wakeup counter\n");
+            if (atomic_load(&loop->stop))
+                break;
+            if (atomic_load(&loop->started))
+                shard_dispatch_all(shard);
+        }
+
+        if ((shard->pollfds[POLL_LISTEN].revents & POLLIN) && !shard_accept(shard))
+            goto error;
+        if (!shard_handle_conns(shard))
+            goto error;
+    }
+    return NULL;
 error:
-    for(size_t i = 0; i < num_connected_workers; ++i) {
-        manager_close_worker_socket(&works[i]);
+    atomic_store(&loop->failed, true);
+    manager_sched_wake(loop->sched);
+    return NULL;
+}
+
+// Остановка и ожидание циклов в отдельных потоках.
+static void loop_stop(MANAGER_LOOP *loop, size_t *num_running)
+{
+    if (!*num_running)
+        return;
+    atomic_store(&loop->stop, true);
+    loop_wake_shards(loop);
+    for (size_t i = 1; i <= *num_running; ++i)
+        pthread_join(loop->shards[i].thread, NULL);
+    *num_running = 0;
+}
+
+// Закрытие сокетов и освобождение циклов после их остановки.
+static void loop_close(MANAGER_LOOP *loop, bool cancel)
+{
+    for (size_t shard_i = 0; loop->shards && shard_i < loop->num_shards; ++shard_i) {
+        MANAGER_SHARD *shard = &loop->shards[shard_i];
+        if (shard->listen_sock_fd >= 0)
+            manager_close_listen_socket(shard->listen_sock_fd);
+        for (size_t i = 0; i < shard->num_conns; ++i) {
+            if (shard->works[i].worker_sock_fd >= 0)
+                manager_close_worker_socket(&shard->works[i], cancel);
+            free(shard->works[i].in_flight);
+            free(shard->works[i].ans_buf);
+        }
+        free(shard->latencies);
+        // eventfd первого цикла принадлежит планировщику.
+        if (shard_i && shard->wake_fd >= 0)
+            close(shard->wake_fd);
+        free(shard->pollfds);
+        free(shard->works);
     }
-    return false;
+    free(loop->shards);
+    loop->shards = NULL;
 }
 
 //============================
 // Интерфейс сервера
 //============================
-int start_manager(INFO_MANAGER *manager, size_t size_of_structure, size_t num_tasks,
-        char *tasks, char *ans) 
+int start_manager_sched(INFO_MANAGER *manager, MANAGER_SCHED *sched)
 {
-    if (!manager || !tasks || !ans)
+    if (!manager || !sched)
         return -1;
-    if (!size_of_structure || !manager->max_time || !manager->is_init || !manager->num_nodes)
+    if (!manager->max_time || !manager->is_init || !manager->num_nodes)
         return -1;
 
-    WORKER_CONN* works = calloc(manager->num_nodes, sizeof(WORKER_CONN));
-    struct pollfd* pollfds = calloc(manager->num_nodes + 1U, sizeof(struct pollfd));
+    size_t num_shards = manager->num_shards ? manager->num_shards : 1;
+    MANAGER_LOOP loop = { .manager = manager, .sched = sched, .num_shards = num_shards };
+    pthread_mutex_init(&loop.lock, NULL);
+    loop.shards = calloc(num_shards, sizeof(*loop.shards));
+    size_t num_running = 0;
+    int64_t start_ms = 0;
+    // Привязка вызывающего потока восстанавливается после работы первого цикла.
+    cpu_set_t saved_cpuset;
+    bool pinned = false;
 
-    if (works == NULL || pollfds == NULL) {
-        goto error_clear;
+    if (manager->trace_path) {
+        trace_enable();
     }
+    uint64_t trace_job = TRACE_START();
 
-    for (size_t conn_i = 0U; conn_i < manager->num_nodes; conn_i++)
-    {
-        works[conn_i].state = CONNECTION_EMPTY;
+    if (loop.shards == NULL) {
+        goto error_clear;
+    }
+    for (size_t i = 0; i < num_shards; ++i) {
+        loop.shards[i].loop = &loop;
+        loop.shards[i].listen_sock_fd = -1;
+        loop.shards[i].wake_fd = -1;
     }
 
     if (!manager_init_socket(manager)) {
         goto error_clear;
     }
-    if(!wait_and_get_info_workers(manager, works, pollfds)) {
-        manager_close_listen_socket(manager);
-        goto error_clear;
+    loop.shards[0].listen_sock_fd = manager->listen_sock_fd;
+    loop.shards[0].wake_fd = sched->wake_fd;
+    for (size_t i = 1; i < num_shards; ++i) {
+        loop.shards[i].listen_sock_fd = manager_listen_socket(manager, true);
+        loop.shards[i].wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (loop.shards[i].listen_sock_fd == -1 || loop.shards[i].wake_fd == -1) {
+            fprintf(stderr, "[start_manager] Unable to create shard %lu\n", i);
+            goto error_close;
+        }
+    }
+    for (size_t i = 0; i < num_shards; ++i) {
+        if (!shard_init(&loop.shards[i], manager->num_nodes / num_shards + 1)) {
+            fprintf(stderr, "[start_manager] Unable to allocate memory\n");
+            goto error_close;
+        }
+    }
+    if (manager->metrics_addr && metrics_start(manager->metrics_addr)) {
+        fprintf(stderr, "[start_manager] Metrics endpoint is disabled\n");
+    }
+    if (manager->record_path && record_open(manager->record_path)) {
+        fprintf(stderr, "[start_manager] Protocol recording is disabled\n");
+    }
+    for (size_t i = 1; i < num_shards; ++i) {
+        if (pthread_create(&loop.shards[i].thread, NULL, shard_thread, &loop.shards[i])) {
+            fprintf(stderr, "[start_manager] Unable to start shard %lu\n", i);
+            goto error_close;
+        }
+        num_running = i;
     }
-    DEBUG("All workers connected\n");
 
-    if (!manager_close_listen_socket(manager)) {
-        goto error_close;
+    MANAGER_SHARD *shard = &loop.shards[0];
+    if (manager->busy_poll_us) {
+        pinned = !pthread_getaffinity_np(pthread_self(), sizeof(saved_cpuset), &saved_cpuset);
+        shard_pin(0);
     }
+    size_t min_nodes = manager->min_nodes ? manager->min_nodes : manager->num_nodes;
+    size_t num_accepted;
+    bool started = false;
+    bool closed = sched_accept_jobs(sched, &loop, &num_accepted);
+    int64_t wait_start_ms = manager_now_ms();
+    fprintf(stderr, "[start_manager] Waiting workers\n");
 
-    time_t start_time = time(NULL);
-    char *ptr_tasks = tasks;
+    while (!closed || sched_num_jobs(&loop)) {
+        int64_t now_ms = manager_now_ms();
+        size_t num_init_workers = atomic_load(&loop.num_init_workers);
+        int timeout_ms = -1;
 
-    for (size_t conn_i = 0; conn_i < manager->num_nodes; ++conn_i) {
-        if(manager_send_tasks(&works[conn_i], size_of_structure, ptr_tasks))
-            goto error_close;
-        poll_manager_wait_for_answer(pollfds,conn_i,&works[conn_i]);
-        ptr_tasks += size_of_structure;
-    }
+        // Старт при кворуме или по истечении времени ожидания, если есть хотя бы один узел.
+        if (!started && (num_init_workers >= min_nodes ||
+                    (manager->grace_ms && num_init_workers && now_ms - wait_start_ms >= manager->grace_ms))) {
+            started = true;
+            start_ms = now_ms;
+            loop.deadline_ms = start_ms + manager->max_time * 1000;
+            fprintf(stderr, "[start_manager] Start with %lu workers\n", num_init_workers);
+            sched_plan_jobs(sched, &loop);
+            atomic_store(&loop.started, true);
+            loop_wake_shards(&loop);
+            shard_dispatch_all(shard);
+        }
 
-    size_t get_answers = 0;
-    fprintf(stderr, "[start_manager] waiting answers\n");
-    while(get_answers != num_tasks && (manager->max_time > time(NULL) - start_time)) {
-        time_t max_wait_time = manager->max_time - (time(NULL) - start_time);
-        int pollret = poll(pollfds, 1U + manager->num_nodes, 1000 * max_wait_time);
+        if (started) {
+            int64_t left_ms = manager->max_time * 1000 - (now_ms - start_ms);
+            if (left_ms <= 0)
+                break;
+            timeout_ms = (int)left_ms;
+        } else if (manager->grace_ms && num_init_workers) {
+            int64_t left_ms = manager->grace_ms - (now_ms - wait_start_ms);
+            timeout_ms = left_ms > 0 ? (int)left_ms : 0;
+        }
+
+        int pollret = shard_poll(shard, timeout_ms);
         if (pollret == -1)
         {
+            if (errno == EINTR)
+                continue;
             fprintf(stderr, "Unable to poll-wait for data on descriptors!\n");
             goto error_close;
         }
+        if (atomic_load(&loop.failed))
+            goto error_close;
 
-        for (size_t conn_i = 0U; conn_i < manager->num_nodes; ++conn_i) {
-            if (pollfds[1U + conn_i].revents & POLLHUP)
-            {  
-                fprintf(stderr, "Unexpected POLLHUP\n");
-                goto error_close;
-            }
-
-            if (pollfds[1U + conn_i].revents & POLLIN)
-            {
-                int ans_size = 0;
-                switch (works[conn_i].state) {
-                case CONNECTION_EMPTY:
-                case GET_INFO:
-                    fprintf(stderr, "Unexpected state!\n");
-                    goto error_close;
-                case WAIT_ANS:
-                    printf("[start_manager] got an answer\n");
-                    if((ans_size = manager_get_worker_ans(&works[conn_i], &ans)) == 0) {
-                        goto error_close;
-                    }
-                    ans += ans_size;
-                    ++get_answers;
-                    manager_close_worker_socket(&works[conn_i]);
-                    works[conn_i].state = WORK_FINISHED;
-                    poll_manager_do_not_wait_for_ans(pollfds,conn_i);
-                case WAIT_TASK:
-                case WORK_FINISHED:
-                }
+        if (shard->pollfds[POLL_WAKEUP].revents & POLLIN)
+        {
+            closed = sched_accept_jobs(sched, &loop, &num_accepted);
+            // Новые задания сразу раздаются свободным кредитам.
+            if (started && num_accepted) {
+                loop_wake_shards(&loop);
+                shard_dispatch_all(shard);
             }
         }
+
+        if ((shard->pollfds[POLL_LISTEN].revents & POLLIN) && !shard_accept(shard))
+            goto error_close;
+        if (!shard_handle_conns(shard))
+            goto error_close;
     }
-    if (time(NULL) - start_time >= manager->max_time) {
+    loop_stop(&loop, &num_running);
+    if (manager->busy_poll_us)
+        loop_report_latency(&loop);
+    // Ошибка по времени - только если остались невыполненные задания: в списке или поданные, но не принятые.
+    if (loop.jobs.num_jobs || sched_has_submitted(sched)) {
         fprintf(stderr, "Time is out\n");
+        sched_estimate_jobs(sched, &loop);
         goto error_close;
     } else {
         fprintf(stderr, "[start_manager] got answers\n");
-        fprintf(stderr, "TIME: %ds\n", time(NULL) - start_time);
+        fprintf(stderr, "TIME: %lds\n", (long)((manager_now_ms() - start_ms) / 1000));
+    }
+    loop_close(&loop, false);
+    // Незакрытый планировщик закрывается: задания, поданные после истечения времени, не выполняются.
+    if (!closed)
+        sched_fail_all(sched, &loop.jobs);
+    free(loop.jobs.jobs);
+    pthread_mutex_destroy(&loop.lock);
+    metrics_stop();
+    record_close();
+    if (pinned)
+        pthread_setaffinity_np(pthread_self(), sizeof(saved_cpuset), &saved_cpuset);
+    TRACE_SPAN("job", trace_job);
+    if (manager->trace_path) {
+        trace_write_json(manager->trace_path);
     }
-    free(pollfds);
-    free(works);
     return 0;
 error_close:
-    for(size_t i = 0; i < manager->num_nodes; ++i) {
-        manager_close_worker_socket(&works[i]);
-    }
+    loop_stop(&loop, &num_running);
     DEBUG("Fall in error_close!\n");
 error_clear:
-    free(pollfds);
-    free(works);
+    loop_close(&loop, true);
+    sched_fail_all(sched, &loop.jobs);
+    free(loop.jobs.jobs);
+    pthread_mutex_destroy(&loop.lock);
     DEBUG("Fall in error_clear!\n");
-    return -1;    
+    metrics_stop();
+    record_close();
+    if (pinned)
+        pthread_setaffinity_np(pthread_self(), sizeof(saved_cpuset), &saved_cpuset);
+    TRACE_SPAN("job", trace_job);
+    if (manager->trace_path) {
+        trace_write_json(manager->trace_path);
+    }
+    return -1;
+}
+
+int start_manager_anytime(INFO_MANAGER *manager, size_t size_of_structure, size_t num_tasks,
+        char *tasks, char *ans, size_t ans_capacity, MANAGER_ESTIMATE *estimate)
+{
+    if (!manager || !tasks || !ans || !ans_capacity)
+        return -1;
+    if (!size_of_structure || !manager->max_time || !manager->is_init || !manager->num_nodes || !num_tasks)
+        return -1;
+
+    // Одно задание через планировщик.
+    MANAGER_SCHED *sched = manager_sched_create();
+    if (!sched)
+        return -1;
+    MANAGER_JOB job = {
+        .size_of_structure = size_of_structure,
+        .num_tasks = num_tasks,
+        .tasks = tasks,
+        .ans = ans,
+        .ans_capacity = ans_capacity,
+        .weight = 1,
+        .estimate = estimate,
+    };
+    int ret = manager_sched_submit(sched, &job);
+    manager_sched_close(sched);
+    if (ret == 0)
+        start_manager_sched(manager, sched);
+    manager_sched_destroy(sched);
+    return ret == 0 && job.done ? job.status : -1;
+}
+
+int start_manager_bounded(INFO_MANAGER *manager, size_t size_of_structure, size_t num_tasks,
+        char *tasks, char *ans, size_t ans_capacity)
+{
+    return start_manager_anytime(manager, size_of_structure, num_tasks, tasks, ans, ans_capacity, NULL);
+}
+
+int start_manager(INFO_MANAGER *manager, size_t size_of_structure, size_t num_tasks, char *tasks, char *ans)
+{
+    return start_manager_bounded(manager, size_of_structure, num_tasks, tasks, ans, MANAGER_ANS_UNBOUNDED);
+}
+
+// Количество циклов из SPECSEM_SHARDS: число или "auto" (по числу ядер); по умолчанию один цикл.
+static size_t manager_env_shards(void)
+{
+    const char *shards = getenv("SPECSEM_SHARDS");
+    if (!shards)
+        return 1;
+    long num_shards = strcmp(shards, "auto") ? atol(shards) : sysconf(_SC_NPROCESSORS_ONLN);
+    return num_shards > 0 ? num_shards : 1;
 }
 
 int info_manager_init(INFO_MANAGER *manager, const char *addr, const char *port, time_t time, int num_nodes) {
@@ -417,6 +1612,15 @@ int info_manager_init(INFO_MANAGER *manager, const char *addr, const char *port,
     manager->listen_addr = *res->ai_addr;
     manager->max_time = time;
     manager->num_nodes = num_nodes;
+    manager->min_nodes = num_nodes;
+    manager->grace_ms = 0;
+    manager->trace_path = getenv("SPECSEM_TRACE");
+    manager->metrics_addr = getenv("SPECSEM_METRICS");
+    manager->record_path = getenv("SPECSEM_RECORD");
+    manager->num_shards = manager_env_shards();
+    const char *busy_poll_us = getenv("SPECSEM_BUSY_POLL");
+    manager->busy_poll_us = busy_poll_us ? atol(busy_poll_us) : 0;
+    manager->latency = (MANAGER_LATENCY){};
     manager->is_init = true;
     freeaddrinfo(res);
     return 0;
@@ -1,13 +1,30 @@
+#ifndef MANAGER_H
+#define MANAGER_H
+
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 #include <arpa/inet.h>
 
+#include "common.h"
+
 #ifdef DEBUGTEST
 #define DEBUG(...) printf(__VA_ARGS__);
 #else
 #define DEBUG(...)
 #endif
 
+//! Задержка обмена задачей: время от отправки задачи до получения ответа без времени вычисления
+//! по данным рабочего узла (сеть, циклы обоих узлов и ожидание в очереди узла), в наносекундах.
+typedef struct
+{
+    //! Количество измеренных ответов.
+    size_t count;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} MANAGER_LATENCY;
+
 //! Структура для работы Управляющего узла
 typedef struct
 {
@@ -15,8 +32,28 @@ typedef struct
     struct sockaddr listen_addr;
     //! Максимальное время работы в секундах.
     time_t max_time;
-    //! Количество рабочих узлов, необходимых для запуска вычисления.
+    //! Ожидаемое количество рабочих узлов.
     size_t num_nodes;
+    //! Кворум: количество рабочих узлов, достаточное для запуска вычисления (по умолчанию num_nodes).
+    size_t min_nodes;
+    //! Время ожидания кворума в миллисекундах, после которого вычисление начинается
+    //! с уже подключившимися узлами (0 - ждать кворума без ограничения).
+    int64_t grace_ms;
+    //! Путь к файлу трассировки в формате trace-event JSON (NULL - трассировка выключена).
+    const char *trace_path;
+    //! Адрес отдачи метрик Prometheus: "host:port", "port" или "unix:/path" (NULL - метрики выключены).
+    const char *metrics_addr;
+    //! Путь к файлу записи событий протокола для воспроизведения (NULL - запись выключена).
+    const char *record_path;
+    //! Количество циклов обработки соединений: первый работает в вызывающем потоке, остальные -
+    //! в своих потоках со своими слушающими сокетами на том же адресе (SO_REUSEPORT).
+    size_t num_shards;
+    //! Режим низкой задержки: время активного ожидания событий в микросекундах, после которого
+    //! цикл засыпает в poll (0 - режим выключен). Циклы закрепляются за ядрами, начиная с последнего,
+    //! сокеты рабочих узлов получают SO_BUSY_POLL, а задержка обмена записывается в latency.
+    uint32_t busy_poll_us;
+    //! Задержка обмена задачами по итогам работы (заполняется в режиме низкой задержки).
+    MANAGER_LATENCY latency;
     //! Дескриптор слушающего сокета для первоначального подключения клиентов.
     int listen_sock_fd;
     //! Флаг, указывающий, была ли структура инициализирована функцией info_manager_init.
@@ -34,6 +71,12 @@ typedef struct
  *
  * \details Функция инициализирует структуру INFO_MANAGER, устанавливая адрес прослушивания,
  *          максимальное время ожидания и требуемое количество рабочих узлов.
+ *          Кворум равен num_nodes, время ожидания кворума не ограничено; поля min_nodes и grace_ms
+ *          можно изменить после вызова. Путь к файлу трассировки берётся из переменной
+ *          окружения SPECSEM_TRACE, адрес отдачи метрик - из SPECSEM_METRICS,
+ *          путь к файлу записи протокола - из SPECSEM_RECORD, количество циклов обработки
+ *          соединений - из SPECSEM_SHARDS (число или "auto" по количеству ядер, по умолчанию 1),
+ *          время активного ожидания режима низкой задержки - из SPECSEM_BUSY_POLL.
  *          После успешной инициализации поле is_init устанавливается в true.
  */
 int info_manager_init(INFO_MANAGER *manager, const char *addr, const char *port, time_t time, int num_nodes);
@@ -47,7 +90,178 @@ int info_manager_init(INFO_MANAGER *manager, const char *addr, const char *port,
  *
  * \return Возвращает 0 в случае успеха, -EINVAL при некорректных аргументах и -1 при возникновении ошибок.
  *
- * \details Функция ожидает подключения рабочих узлов в количестве, указанном в структуре INFO_MANAGER,
- *          получает информацию о количестве их ядер и распределяет задачи по принципу "одна задача - одно ядро".
+ * \details Функция ожидает подключения кворума рабочих узлов (min_nodes) или истечения grace_ms,
+ *          после чего раздаёт задачи: каждому узлу выдаётся столько задач, сколько кредитов он заявил
+ *          при подключении, и после каждого ответа узел получает следующую задачу.
+ *          Узлы, подключившиеся во время вычисления, получают ещё не выданные задачи, а задачи
+ *          отключившихся узлов возвращаются в очередь. Результаты записываются в порядке получения.
+ *          Если время max_time истекло, узлам отправляется сообщение отмены задания.
+ *          Выполняется как единственное задание планировщика (см. start_manager_sched).
+ *          Размер ans не проверяется: область должна вмещать ответы всех задач; для ответов,
+ *          размер которых задаёт рабочий узел, следует использовать start_manager_bounded.
  */
 int start_manager(INFO_MANAGER *manager, size_t size_of_structure, size_t num_tasks, char *tasks, char *ans);
+
+//! Размер области ответов не ограничен (start_manager).
+#define MANAGER_ANS_UNBOUNDED SIZE_MAX
+
+/*!
+ * \brief Функция для старта работы Управляющего узла с ограниченной областью ответов.
+ *
+ * \param[in] ans_capacity Размер области ans в байтах: ответ, который в неё не помещается, разрывает
+ *            соединение с узлом, а задача возвращается в очередь.
+ *
+ * \details Работает как start_manager.
+ */
+int start_manager_bounded(INFO_MANAGER *manager, size_t size_of_structure, size_t num_tasks, char *tasks,
+        char *ans, size_t ans_capacity);
+
+//! Оценка суммы результатов задания (первых полей double ответов).
+typedef struct
+{
+    //! Значение.
+    double value;
+    //! Оценка погрешности (0 - значение точное, INFINITY - нет данных ни по одной задаче).
+    double error;
+    //! Доля выполненной работы от 0 до 1.
+    double coverage;
+} MANAGER_ESTIMATE;
+
+/*!
+ * \brief Функция для старта работы Управляющего узла с возвратом оценки по истечении времени.
+ *
+ * \param[out] estimate Сумма первых полей double всех ответов либо её оценка.
+ *
+ * \return 0, если получены все ответы (estimate точная), 1, если истекло время max_time
+ *         и возвращена оценка, -1 при ошибке.
+ *
+ * \details Работает как start_manager_bounded. Если рабочие узлы отправляют промежуточные
+ *          результаты (INFO_WORKER::partial_ms), то по истечении max_time оценка складывается
+ *          из полученных ответов и последних промежуточных результатов выполняемых задач.
+ *          Задачи, по которым нет ни ответа, ни оценки (невыданные и ждущие в очереди узла),
+ *          экстраполируются средним результатом задач с данными (задачи считаются однородными),
+ *          а к погрешности добавляется интервал предсказания их суммы по распределению
+ *          Стьюдента с уровнем 95%.
+ *          Погрешность бесконечна, только если данных нет ни по одной задаче; coverage
+ *          показывает долю выполненной работы.
+ */
+int start_manager_anytime(INFO_MANAGER *manager, size_t size_of_structure, size_t num_tasks,
+        char *tasks, char *ans, size_t ans_capacity, MANAGER_ESTIMATE *estimate);
+
+//================
+// Планировщик нескольких заданий.
+//================
+
+//! Рабочие узлы, подключённые к моменту планирования задания
+typedef struct
+{
+    //! Количество узлов и их ядер.
+    size_t num_nodes;
+    size_t num_cores;
+    //! Ядра узлов, передавших профиль производительности при подключении.
+    size_t profiled_cores;
+    //! Суммарное количество вычислений каждой функции FUNC_TABLE в секунду по узлам с профилем.
+    double evals_per_sec[NOT_SUPPORT];
+    //! Время до истечения max_time в секундах.
+    double time_left;
+} MANAGER_CLUSTER;
+
+typedef struct manager_job MANAGER_JOB;
+
+//! Задание для планировщика
+struct manager_job
+{
+    //! Размер одной задачи.
+    size_t size_of_structure;
+    //! Количество задач.
+    size_t num_tasks;
+    //! Задачи, записанные подряд.
+    char *tasks;
+    //! Область памяти, в которую последовательно записываются результаты.
+    char *ans;
+    //! Размер области ans в байтах: ответ, который в неё не помещается, разрывает соединение
+    //! с узлом, а задача возвращается в очередь (MANAGER_ANS_UNBOUNDED - без проверки).
+    size_t ans_capacity;
+    //! Приоритет: пока у задания с большим приоритетом есть невыданные задачи,
+    //! задачи заданий с меньшим приоритетом не выдаются.
+    int priority;
+    //! Вес в справедливой очереди среди заданий одного приоритета
+    //! (доля выдаваемых задач пропорциональна весу; 0 - вес 1).
+    double weight;
+    //! Вытесняемое задание выдаётся только узлам без выполняемых задач и не занимает
+    //! их кредиты заранее, поэтому задание с большим приоритетом получает узел
+    //! на границе ближайшей задачи.
+    bool preemptible;
+    //! Если не NULL, сюда записывается сумма первых полей double ответов, а по истечении
+    //! max_time - её оценка (см. start_manager_anytime).
+    MANAGER_ESTIMATE *estimate;
+    //! Результат: 0 - все ответы получены, 1 - истекло время и записана оценка,
+    //! -1 - ошибка или истекло время (заполняется планировщиком).
+    int status;
+    //! Задание завершено (заполняется планировщиком).
+    bool done;
+    //! Планирование по подключённым узлам (NULL - задачи заданы при подаче): вызывается один раз
+    //! в цикле Управляющего узла до выдачи первой задачи задания, после набора кворума. Функция
+    //! заполняет size_of_structure, num_tasks, tasks, ans и ans_capacity (память освобождает
+    //! вызывающий после завершения задания); ненулевой возврат отклоняет задание со статусом -1
+    //! без выдачи задач.
+    int (*plan)(MANAGER_JOB *job, const MANAGER_CLUSTER *cluster);
+    //! Данные для функции планирования.
+    void *plan_arg;
+};
+
+typedef struct manager_sched MANAGER_SCHED;
+
+//! Создание планировщика; NULL при ошибке.
+MANAGER_SCHED *manager_sched_create(void);
+
+/*!
+ * \brief Функция для подачи задания планировщику.
+ *
+ * \param[in] job Задание; память задания, задач и ответов должна оставаться доступной до завершения.
+ *            Задачи и ответы задания с функцией plan могут быть не заданы.
+ *
+ * \return 0 в случае успеха, -1 при некорректных аргументах или если планировщик закрыт.
+ *
+ * \details Может вызываться из любого потока, в том числе во время работы start_manager_sched:
+ *          задание сразу получает свободные кредиты рабочих узлов.
+ */
+int manager_sched_submit(MANAGER_SCHED *sched, MANAGER_JOB *job);
+
+//! Ожидание завершения задания; возвращает job->status.
+int manager_sched_wait(MANAGER_SCHED *sched, MANAGER_JOB *job);
+
+//! Закрытие планировщика: новые задания не принимаются, start_manager_sched завершается
+//! после выполнения поданных.
+void manager_sched_close(MANAGER_SCHED *sched);
+
+//! Освобождение планировщика после завершения start_manager_sched.
+void manager_sched_destroy(MANAGER_SCHED *sched);
+
+/*!
+ * \brief Функция для работы Управляющего узла с несколькими заданиями.
+ *
+ * \param[in] manager Структура INFO_MANAGER, инициализированная функцией info_manager_init.
+ * \param[in] sched Планировщик, в который задания подаются через manager_sched_submit.
+ *
+ * \return 0, если все задания выполнены и планировщик закрыт либо к истечению max_time не осталось
+ *         невыполненных заданий (планировщик при этом закрывается), -1 при ошибке или если по истечении
+ *         max_time остались невыполненные задания.
+ *
+ * \details Подключение узлов и раздача задач выполняются как в start_manager. Каждый освободившийся
+ *          кредит узла получает задачу задания с наибольшим приоритетом, а среди заданий одного
+ *          приоритета - задания с наименьшим виртуальным временем (взвешенная справедливая очередь:
+ *          каждая выданная задача увеличивает виртуальное время задания на 1 / weight). Новое задание
+ *          начинает с текущего виртуального времени, поэтому небольшие задания выполняются быстро
+ *          и во время длинного. Ответы записываются в ans своего задания, завершение задания
+ *          сообщается manager_sched_wait. Время max_time отсчитывается от старта для всей работы
+ *          планировщика; при его истечении задания с запрошенной оценкой завершаются со статусом 1,
+ *          остальные невыполненные - с ошибкой. Задания с функцией plan планируются при старте
+ *          (поданные позже - при приёме) по узлам, подключённым к этому моменту. При num_shards > 1
+ *          соединения распределяются между циклами в отдельных потоках: каждый цикл сам принимает
+ *          ответы и выдаёт задачи своим узлам, общий список заданий блокируется только на время
+ *          выбора задач.
+ */
+int start_manager_sched(INFO_MANAGER *manager, MANAGER_SCHED *sched);
+
+#endif // MANAGER_H
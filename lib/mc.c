@@ -0,0 +1,409 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "mc.h"
+
+//=================================
+// Счётчиковый генератор Philox4x32-10.
+//=================================
+// Значение зависит только от ключа и счётчика, поэтому каждый поток любого узла
+// получает свои точки без согласования с остальными.
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+static void philox4x32(const uint32_t ctr_in[4], uint64_t seed, uint32_t out[4])
+{
+    uint32_t c0 = ctr_in[0], c1 = ctr_in[1], c2 = ctr_in[2], c3 = ctr_in[3];
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+
+    for (int round = 0; round < 10; ++round) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+static inline double u01(uint32_t hi, uint32_t lo)
+{
+    return (double)((((uint64_t)hi << 32) | lo) >> 11) * 0x1.0p-53;
+}
+
+// Точка номер index в [0,1)^dims; stream отделяет разные назначения потока чисел.
+static void philox_point(uint64_t seed, uint64_t index, uint32_t stream, uint32_t dims, double *x)
+{
+    uint32_t out[4];
+    for (uint32_t block = 0; 2 * block < dims; ++block) {
+        uint32_t ctr[4] = { (uint32_t)index, (uint32_t)(index >> 32), block, stream };
+        philox4x32(ctr, seed, out);
+        x[2 * block] = u01(out[0], out[1]);
+        if (2 * block + 1 < dims)
+            x[2 * block + 1] = u01(out[2], out[3]);
+    }
+}
+
+//=================================
+// Последовательности Соболя и Холтона.
+//=================================
+
+#define SOBOL_BITS 32
+
+// Направляющие числа Джо-Куо (new-joe-kuo-6.21201) для измерений 2..20.
+static const struct {
+    uint32_t s;
+    uint32_t a;
+    uint32_t m[7];
+} sobol_params[MC_MAX_DIMS - 1] = {
+    { 1,  0, { 1 } },
+    { 2,  1, { 1, 3 } },
+    { 3,  1, { 1, 3, 1 } },
+    { 3,  2, { 1, 1, 1 } },
+    { 4,  1, { 1, 1, 3, 3 } },
+    { 4,  4, { 1, 3, 5, 13 } },
+    { 5,  2, { 1, 1, 5, 5, 17 } },
+    { 5,  4, { 1, 1, 5, 5, 5 } },
+    { 5,  7, { 1, 1, 7, 11, 19 } },
+    { 5, 11, { 1, 1, 5, 1, 1 } },
+    { 5, 13, { 1, 1, 1, 3, 11 } },
+    { 5, 14, { 1, 3, 5, 5, 31 } },
+    { 6,  1, { 1, 3, 3, 9, 7, 49 } },
+    { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+    { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+    { 6, 19, { 1, 1, 1, 15, 7, 5 } },
+    { 6, 22, { 1, 3, 1, 15, 13, 25 } },
+    { 6, 25, { 1, 1, 5, 5, 19, 61 } },
+    { 7,  1, { 1, 3, 7, 11, 23, 15, 103 } },
+};
+
+static void sobol_directions(uint32_t dims, uint32_t v[][SOBOL_BITS])
+{
+    for (uint32_t k = 0; k < SOBOL_BITS; ++k)
+        v[0][k] = 1U << (SOBOL_BITS - 1 - k);
+
+    for (uint32_t d = 1; d < dims; ++d) {
+        uint32_t s = sobol_params[d - 1].s;
+        uint32_t a = sobol_params[d - 1].a;
+        for (uint32_t k = 0; k < s; ++k)
+            v[d][k] = sobol_params[d - 1].m[k] << (SOBOL_BITS - 1 - k);
+        for (uint32_t k = s; k < SOBOL_BITS; ++k) {
+            v[d][k] = v[d][k - s] ^ (v[d][k - s] >> s);
+            for (uint32_t j = 1; j < s; ++j)
+                v[d][k] ^= ((a >> (s - 1 - j)) & 1U) * v[d][k - j];
+        }
+    }
+}
+
+static const uint32_t halton_primes[MC_MAX_DIMS] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71
+};
+
+static double radical_inverse(uint64_t index, uint32_t base)
+{
+    double inv_base = 1.0 / base;
+    double factor = inv_base;
+    double result = 0;
+    while (index) {
+        result += (double)(index % base) * factor;
+        index /= base;
+        factor *= inv_base;
+    }
+    return result;
+}
+
+//=================================
+// Подынтегральные функции.
+//=================================
+
+static double (*custom_integrand)(const double *x, uint32_t dims) = NULL;
+
+void mc_set_integrand(double (*integrand)(const double *x, uint32_t dims))
+{
+    custom_integrand = integrand;
+}
+
+static double mc_eval(const struct mc_task *task, const double *x)
+{
+    double acc;
+    switch (task->func) {
+    case MC_OSCILLATORY:
+        acc = 2 * M_PI * task->shift[0];
+        for (uint32_t i = 0; i < task->dims; ++i)
+            acc += task->coef[i] * x[i];
+        return cos(acc);
+    case MC_PRODUCT_PEAK:
+        acc = 1;
+        for (uint32_t i = 0; i < task->dims; ++i) {
+            double d = x[i] - task->shift[i];
+            acc /= 1 / (task->coef[i] * task->coef[i]) + d * d;
+        }
+        return acc;
+    case MC_GAUSSIAN:
+        acc = 0;
+        for (uint32_t i = 0; i < task->dims; ++i) {
+            double d = task->coef[i] * (x[i] - task->shift[i]);
+            acc += d * d;
+        }
+        return exp(-acc);
+    case MC_CONTINUOUS:
+        acc = 0;
+        for (uint32_t i = 0; i < task->dims; ++i)
+            acc += task->coef[i] * fabs(x[i] - task->shift[i]);
+        return exp(-acc);
+    case MC_CUSTOM:
+        return custom_integrand(x, task->dims);
+    default:
+        return NAN;
+    }
+}
+
+static void mc_add_point(const struct mc_task *task, const double *u, double *x,
+        struct mc_result *res, uint32_t replicate)
+{
+    for (uint32_t i = 0; i < task->dims; ++i)
+        x[i] = task->lower[i] + (task->upper[i] - task->lower[i]) * u[i];
+    double f = mc_eval(task, x);
+    res->n++;
+    res->sum += f;
+    res->sumsq += f * f;
+    res->rep_sum[replicate] += f;
+}
+
+//============================
+// Интерфейс Управляющего узла
+//============================
+
+int mc_job_init(struct mc_task *job, MC_METHOD method, MC_FUNC_TABLE func, uint32_t dims,
+        const double *lower, const double *upper, uint64_t num_samples, uint64_t seed)
+{
+    if (!job || !lower || !upper || !dims || dims > MC_MAX_DIMS || func >= MC_NOT_SUPPORT)
+        return -1;
+    if (method == MC_SOBOL && num_samples > (1ULL << SOBOL_BITS))
+        return -1;
+
+    memset(job, 0, sizeof(*job));
+    job->size_of_structure = sizeof(*job);
+    job->method = method;
+    job->func = func;
+    job->dims = dims;
+    job->replicates = method == MC_PSEUDO ? 1 : 8;
+    job->seed = seed;
+    job->first = 0;
+    job->num_samples = num_samples;
+    for (uint32_t i = 0; i < dims; ++i) {
+        job->lower[i] = lower[i];
+        job->upper[i] = upper[i];
+        job->coef[i] = 1;
+        job->shift[i] = 0.5;
+    }
+    return 0;
+}
+
+int mc_make_tasks(const struct mc_task *job, size_t num_tasks, struct mc_task *tasks)
+{
+    if (!job || !tasks || !num_tasks || !job->replicates || job->replicates > MC_MAX_REPLICATES)
+        return -1;
+
+    uint64_t first = job->first;
+    for (size_t i = 0; i < num_tasks; ++i) {
+        tasks[i] = *job;
+        tasks[i].first = first;
+        tasks[i].num_samples = job->num_samples / num_tasks;
+        if (i < job->num_samples % num_tasks)
+            ++tasks[i].num_samples;
+        first += tasks[i].num_samples;
+    }
+    return 0;
+}
+
+double mc_t_quantile(double z, uint32_t df)
+{
+    if (df == 0)
+        return INFINITY;
+    // Разложение Корниша-Фишера квантиля t по степеням 1/df: для df = 7 и z = 1.96 даёт 2.364
+    // (точно 2.365), при df >= 2 ошибка меньше 1%, при df = 1 - около 10% вниз.
+    double z2 = z * z;
+    double nu = df;
+    double g1 = z * (z2 + 1) / 4;
+    double g2 = z * ((5 * z2 + 16) * z2 + 3) / 96;
+    double g3 = z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / 384;
+    double g4 = z * ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) / 92160;
+    return z + (g1 + (g2 + (g3 + g4 / nu) / nu) / nu) / nu;
+}
+
+int mc_estimate(const struct mc_task *job, const struct mc_result *results, size_t num_results,
+        double z, MC_ESTIMATE *est)
+{
+    if (!job || !results || !est)
+        return -1;
+
+    struct mc_result total = {};
+    for (size_t i = 0; i < num_results; ++i) {
+        total.n += results[i].n;
+        total.sum += results[i].sum;
+        total.sumsq += results[i].sumsq;
+        for (uint32_t r = 0; r < job->replicates; ++r)
+            total.rep_sum[r] += results[i].rep_sum[r];
+    }
+    if (total.n < 2)
+        return -1;
+
+    double volume = 1;
+    for (uint32_t i = 0; i < job->dims; ++i)
+        volume *= job->upper[i] - job->lower[i];
+
+    double mean = total.sum / total.n;
+    double se;
+    double t = z;
+    if (job->method == MC_PSEUDO || job->replicates < 2) {
+        double var = (total.sumsq - total.n * mean * mean) / (total.n - 1);
+        se = sqrt(fmax(var, 0) / total.n);
+    } else {
+        // Средние по репликам независимы и одинаково распределены.
+        uint64_t per_replicate = total.n / job->replicates;
+        double var = 0;
+        for (uint32_t r = 0; r < job->replicates; ++r) {
+            double d = total.rep_sum[r] / per_replicate - mean;
+            var += d * d;
+        }
+        var /= job->replicates - 1;
+        se = sqrt(var / job->replicates);
+        // Реплик мало (по умолчанию 8), поэтому интервал строится по распределению Стьюдента.
+        t = mc_t_quantile(z, job->replicates - 1);
+    }
+
+    est->value = volume * mean;
+    est->std_error = fabs(volume) * se;
+    est->ci_low = est->value - t * est->std_error;
+    est->ci_high = est->value + t * est->std_error;
+    est->evals = total.n;
+    return 0;
+}
+
+//============================
+// Интерфейс исполнителя
+//============================
+
+int mc_data_for_threads(INFO_WORKER *worker)
+{
+    struct mc_task *task = (struct mc_task *)worker->data;
+    if (!task || task->dims == 0 || task->dims > MC_MAX_DIMS || task->func >= MC_NOT_SUPPORT)
+        return -1;
+    if (task->replicates == 0 || task->replicates > MC_MAX_REPLICATES)
+        return -1;
+    if (task->func == MC_CUSTOM && !custom_integrand) {
+        fprintf(stderr, "[mc_data_for_threads] integrand is not registered\n");
+        return -1;
+    }
+
+    struct mc_task *tasks = calloc(worker->n_cores, sizeof(*tasks));
+    if (!tasks) return -1;
+
+    if (mc_make_tasks(task, worker->n_cores, tasks)) {
+        free(tasks);
+        return -1;
+    }
+    for (int i = 0; i < worker->n_cores; ++i)
+        memset(&tasks[i].partial, 0, sizeof(tasks[i].partial));
+
+    worker->data = (char *)tasks;
+    worker->size_of_structure = sizeof(*tasks);
+    free(task);
+    return 0;
+}
+
+void *mc_thread_func(void *t_args)
+{
+    struct mc_task *task = (struct mc_task *)t_args;
+    struct mc_result *res = &task->partial;
+    uint64_t end = task->first + task->num_samples;
+    double u[MC_MAX_DIMS], x[MC_MAX_DIMS], shifted[MC_MAX_DIMS];
+
+    if (task->method == MC_PSEUDO) {
+        for (uint64_t i = task->first; i < end; ++i) {
+            if (!((i - task->first) & (WORKER_CANCEL_BLOCK - 1)) && worker_cancelled())
+                break;
+            philox_point(task->seed, i, 0, task->dims, u);
+            mc_add_point(task, u, x, res, 0);
+        }
+        return NULL;
+    }
+
+    // Случайные сдвиги реплик берутся из отдельного потока генератора.
+    double shift[MC_MAX_REPLICATES][MC_MAX_DIMS];
+    for (uint32_t r = 0; r < task->replicates; ++r)
+        philox_point(task->seed, r, 1, task->dims, shift[r]);
+
+    uint32_t v[MC_MAX_DIMS][SOBOL_BITS];
+    uint32_t point[MC_MAX_DIMS];
+    if (task->method == MC_SOBOL) {
+        sobol_directions(task->dims, v);
+        // Начальная точка в порядке кода Грея, далее - по одному XOR на измерение.
+        uint64_t gray = task->first ^ (task->first >> 1);
+        for (uint32_t d = 0; d < task->dims; ++d) {
+            point[d] = 0;
+            for (uint32_t k = 0; k < SOBOL_BITS; ++k)
+                if ((gray >> k) & 1U)
+                    point[d] ^= v[d][k];
+        }
+    }
+
+    for (uint64_t i = task->first; i < end; ++i) {
+        if (!((i - task->first) & (WORKER_CANCEL_BLOCK - 1)) && worker_cancelled())
+            break;
+        if (task->method == MC_SOBOL) {
+            for (uint32_t d = 0; d < task->dims; ++d)
+                u[d] = point[d] * 0x1.0p-32;
+            if (i + 1 < end) {
+                uint32_t bit = (uint32_t)__builtin_ctzll(~i);
+                for (uint32_t d = 0; d < task->dims; ++d)
+                    point[d] ^= v[d][bit];
+            }
+        } else {
+            for (uint32_t d = 0; d < task->dims; ++d)
+                u[d] = radical_inverse(i + 1, halton_primes[d]);
+        }
+
+        for (uint32_t r = 0; r < task->replicates; ++r) {
+            for (uint32_t d = 0; d < task->dims; ++d) {
+                shifted[d] = u[d] + shift[r][d];
+                if (shifted[d] >= 1)
+                    shifted[d] -= 1;
+            }
+            mc_add_point(task, shifted, x, res, r);
+        }
+    }
+    return NULL;
+}
+
+void mc_collect(INFO_WORKER *worker)
+{
+    struct mc_task *tasks = (struct mc_task *)worker->data;
+    struct mc_result *result = (struct mc_result *)worker->result;
+
+    memset(result, 0, sizeof(*result));
+    for (int i = 0; i < worker->n_cores; ++i) {
+        result->n += tasks[i].partial.n;
+        result->sum += tasks[i].partial.sum;
+        result->sumsq += tasks[i].partial.sumsq;
+        for (uint32_t r = 0; r < MC_MAX_REPLICATES; ++r)
+            result->rep_sum[r] += tasks[i].partial.rep_sum[r];
+    }
+}
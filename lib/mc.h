@@ -0,0 +1,156 @@
+//================
+// Многомерное интегрирование методами Монте-Карло и квази-Монте-Карло.
+//================
+#include <stddef.h>
+#include <stdint.h>
+
+#include "worker.h"
+
+//! Максимальная размерность области интегрирования.
+#define MC_MAX_DIMS 20
+//! Максимальное число независимых рандомизаций (реплик) для квази-Монте-Карло.
+#define MC_MAX_REPLICATES 16
+
+//! Способ генерации точек выборки.
+typedef enum
+{
+    // Псевдослучайные точки из счётчикового генератора Philox4x32-10.
+    MC_PSEUDO,
+    // Последовательность Соболя со случайным сдвигом.
+    MC_SOBOL,
+    // Последовательность Холтона со случайным сдвигом.
+    MC_HALTON,
+} MC_METHOD;
+
+//! Встроенные подынтегральные функции (тестовые семейства Генца).
+typedef enum
+{
+    // cos(2*pi*shift[0] + sum(coef[i] * x[i]))
+    MC_OSCILLATORY,
+    // prod(1 / (coef[i]^-2 + (x[i] - shift[i])^2))
+    MC_PRODUCT_PEAK,
+    // exp(-sum(coef[i]^2 * (x[i] - shift[i])^2))
+    MC_GAUSSIAN,
+    // exp(-sum(coef[i] * |x[i] - shift[i]|))
+    MC_CONTINUOUS,
+    // Функция, зарегистрированная на исполнителе через mc_set_integrand.
+    MC_CUSTOM,
+    MC_NOT_SUPPORT,
+} MC_FUNC_TABLE;
+
+//! Частичный результат: суммы значений функции по обработанным точкам.
+struct mc_result {
+    // Количество вычисленных значений функции.
+    uint64_t n;
+    // Сумма значений функции.
+    double sum;
+    // Сумма квадратов значений функции.
+    double sumsq;
+    // Суммы значений по каждой реплике (только для квази-Монте-Карло).
+    double rep_sum[MC_MAX_REPLICATES];
+};
+
+//! Задача для вычисления на исполнителе (и на отдельном потоке исполнителя).
+struct mc_task {
+    // Размер структуры (по соглашению библиотеки - первое поле задачи).
+    size_t size_of_structure;
+    // Способ генерации точек (MC_METHOD).
+    uint32_t method;
+    // Подынтегральная функция (MC_FUNC_TABLE).
+    uint32_t func;
+    // Размерность.
+    uint32_t dims;
+    // Число реплик для квази-Монте-Карло.
+    uint32_t replicates;
+    // Ключ генератора: одинаковый ключ даёт одинаковую выборку на любом разбиении.
+    uint64_t seed;
+    // Номер первой точки выборки и количество точек.
+    uint64_t first;
+    uint64_t num_samples;
+    // Границы области интегрирования.
+    double lower[MC_MAX_DIMS];
+    double upper[MC_MAX_DIMS];
+    // Параметры встроенных функций.
+    double coef[MC_MAX_DIMS];
+    double shift[MC_MAX_DIMS];
+    // Результат потока (заполняется на исполнителе).
+    struct mc_result partial;
+};
+
+//! Итоговая оценка интеграла.
+typedef struct
+{
+    // Оценка значения интеграла.
+    double value;
+    // Стандартная ошибка оценки.
+    double std_error;
+    // Границы доверительного интервала.
+    double ci_low;
+    double ci_high;
+    // Общее число вычислений функции.
+    uint64_t evals;
+} MC_ESTIMATE;
+
+/*!
+ * \brief Функция для инициализации описания задачи интегрирования.
+ *
+ * \param[out] job Описание задачи.
+ * \param[in] method Способ генерации точек.
+ * \param[in] func Подынтегральная функция.
+ * \param[in] dims Размерность (не больше MC_MAX_DIMS).
+ * \param[in] lower, upper Границы области интегрирования.
+ * \param[in] num_samples Количество точек (для квази-Монте-Карло - в каждой реплике).
+ * \param[in] seed Ключ генератора случайных чисел.
+ *
+ * \return 0 в случае успеха, -1 при некорректных аргументах.
+ *
+ * \details Коэффициенты встроенных функций устанавливаются в coef[i] = 1, shift[i] = 0.5,
+ *          для квази-Монте-Карло используется 8 реплик. Поля можно изменить после вызова.
+ */
+int mc_job_init(struct mc_task *job, MC_METHOD method, MC_FUNC_TABLE func, uint32_t dims,
+        const double *lower, const double *upper, uint64_t num_samples, uint64_t seed);
+
+/*!
+ * \brief Функция для разбиения задачи на подзадачи для Управляющего узла.
+ *
+ * \param[in] job Описание задачи.
+ * \param[in] num_tasks Количество подзадач.
+ * \param[out] tasks Массив из num_tasks подзадач.
+ *
+ * \details Подзадачи получают непересекающиеся отрезки номеров точек, поэтому результат
+ *          не зависит ни от числа узлов, ни от числа ядер на них.
+ */
+int mc_make_tasks(const struct mc_task *job, size_t num_tasks, struct mc_task *tasks);
+
+/*!
+ * \brief Функция для объединения результатов рабочих узлов в оценку интеграла.
+ *
+ * \param[in] job Описание задачи.
+ * \param[in] results Результаты, полученные от start_manager.
+ * \param[in] num_results Количество результатов.
+ * \param[in] z Квантиль нормального распределения (например, 1.96 для 95%).
+ * \param[out] est Оценка интеграла и доверительный интервал.
+ *
+ * \details Для псевдослучайных точек ошибка оценивается по сумме квадратов,
+ *          для квази-Монте-Карло - по разбросу между независимыми репликами; в этом случае
+ *          z переводится в квантиль распределения Стьюдента с replicates - 1 степенями
+ *          свободы того же уровня (для 8 реплик 1.96 становится 2.36).
+ */
+int mc_estimate(const struct mc_task *job, const struct mc_result *results, size_t num_results,
+        double z, MC_ESTIMATE *est);
+
+//! Квантиль распределения Стьюдента с df степенями свободы того же уровня, что квантиль z
+//! нормального распределения (приближённо; INFINITY при df = 0).
+double mc_t_quantile(double z, uint32_t df);
+
+// Регистрация пользовательской функции для MC_CUSTOM (на исполнителе).
+void mc_set_integrand(double (*integrand)(const double *x, uint32_t dims));
+
+// Разбиение полученной задачи по ядрам исполнителя.
+int mc_data_for_threads(INFO_WORKER *worker);
+
+// Процедура потока: вычисление сумм по своему отрезку точек.
+void *mc_thread_func(void *t_args);
+
+// Сложение результатов потоков в worker->result.
+void mc_collect(INFO_WORKER *worker);
@@ -0,0 +1,415 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "metrics.h"
+
+//================
+// Гистограммы
+//================
+// Логарифмически-линейные корзины в микросекундах, как в HDR Histogram: значения меньше
+// HIST_SUB хранятся точно, каждая следующая степень двойки делится на HIST_SUB корзин
+// (относительная погрешность не больше 1 / HIST_SUB, то есть 6%: этого достаточно, чтобы
+// отличать p99 от p95 по histogram_quantile; гистограмма - 464 корзины).
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1U << HIST_SUB_BITS)
+// Значения от 2^HIST_MAX_BITS мкс (около 71 минуты) попадают только в корзину +Inf.
+#define HIST_MAX_BITS 32
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct metrics_hist {
+    // Последний элемент - значения вне диапазона.
+    _Atomic uint64_t buckets[HIST_BUCKETS + 1];
+    _Atomic uint64_t sum_us;
+};
+
+static size_t hist_index(uint64_t us)
+{
+    if (us < HIST_SUB)
+        return us;
+    if (us >> HIST_MAX_BITS)
+        return HIST_BUCKETS;
+    unsigned exp = 63 - __builtin_clzll(us);
+    return (exp - HIST_SUB_BITS + 1) * HIST_SUB + ((us >> (exp - HIST_SUB_BITS)) - HIST_SUB);
+}
+
+// Граница корзины: все её значения строго меньше результата.
+static uint64_t hist_upper(size_t index)
+{
+    if (index < HIST_SUB)
+        return index + 1;
+    unsigned shift = index / HIST_SUB - 1;
+    return ((uint64_t)(HIST_SUB + index % HIST_SUB) << shift) + (1ULL << shift);
+}
+
+static void hist_record(struct metrics_hist *hist, uint64_t us)
+{
+    atomic_fetch_add_explicit(&hist->buckets[hist_index(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum_us, us, memory_order_relaxed);
+}
+
+//================
+// Счётчики
+//================
+struct metrics_worker {
+    _Atomic bool up;
+    _Atomic int32_t cores;
+    _Atomic uint32_t in_flight;
+    _Atomic uint64_t completed;
+};
+
+bool metrics_enabled = false;
+
+static struct metrics_worker workers[METRICS_MAX_WORKERS];
+static _Atomic int64_t workers_connected;
+static _Atomic int64_t chunks_in_flight;
+static _Atomic uint64_t chunks_completed;
+static _Atomic uint64_t bytes_sent;
+static _Atomic uint64_t bytes_received;
+static _Atomic uint64_t worker_reconnects;
+static _Atomic uint64_t worker_disconnects;
+static struct metrics_hist rtt_hist;
+static struct metrics_hist compute_hist;
+
+#define RELAXED_ADD(var, value) atomic_fetch_add_explicit(&(var), (value), memory_order_relaxed)
+#define RELAXED_LOAD(var) atomic_load_explicit(&(var), memory_order_relaxed)
+
+uint64_t metrics_now_ns(void)
+{
+    if (!metrics_enabled)
+        return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct metrics_worker *metrics_worker_up(size_t conn_i, int n_cores, bool late)
+{
+    if (!metrics_enabled)
+        return NULL;
+    RELAXED_ADD(workers_connected, 1);
+    if (late)
+        RELAXED_ADD(worker_reconnects, 1);
+    if (conn_i >= METRICS_MAX_WORKERS)
+        return NULL;
+
+    struct metrics_worker *worker = &workers[conn_i];
+    atomic_store_explicit(&worker->cores, n_cores, memory_order_relaxed);
+    atomic_store_explicit(&worker->in_flight, 0, memory_order_relaxed);
+    atomic_store_explicit(&worker->completed, 0, memory_order_relaxed);
+    atomic_store_explicit(&worker->up, true, memory_order_relaxed);
+    return worker;
+}
+
+void metrics_worker_down(struct metrics_worker *worker, uint32_t num_in_flight)
+{
+    if (!metrics_enabled)
+        return;
+    RELAXED_ADD(workers_connected, -1);
+    RELAXED_ADD(worker_disconnects, 1);
+    RELAXED_ADD(chunks_in_flight, -(int64_t)num_in_flight);
+    if (worker) {
+        atomic_store_explicit(&worker->up, false, memory_order_relaxed);
+        atomic_store_explicit(&worker->in_flight, 0, memory_order_relaxed);
+    }
+}
+
+void metrics_task_sent(struct metrics_worker *worker, size_t bytes)
+{
+    if (!metrics_enabled)
+        return;
+    RELAXED_ADD(bytes_sent, bytes);
+    RELAXED_ADD(chunks_in_flight, 1);
+    if (worker)
+        RELAXED_ADD(worker->in_flight, 1);
+}
+
+void metrics_task_done(struct metrics_worker *worker, uint64_t sent_ns, uint32_t compute_us)
+{
+    if (!metrics_enabled)
+        return;
+    RELAXED_ADD(chunks_completed, 1);
+    RELAXED_ADD(chunks_in_flight, -1);
+    if (worker) {
+        RELAXED_ADD(worker->in_flight, -1);
+        RELAXED_ADD(worker->completed, 1);
+    }
+    if (sent_ns)
+        hist_record(&rtt_hist, (metrics_now_ns() - sent_ns) / 1000);
+    // 0 - узел не сообщил время вычисления.
+    if (compute_us)
+        hist_record(&compute_hist, compute_us);
+}
+
+void metrics_bytes_received(size_t bytes)
+{
+    if (!metrics_enabled)
+        return;
+    RELAXED_ADD(bytes_received, bytes);
+}
+
+//================
+// Текстовый формат Prometheus
+//================
+static void write_hist(FILE *out, const char *name, const char *help, struct metrics_hist *hist)
+{
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t count = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; ++i) {
+        count += RELAXED_LOAD(hist->buckets[i]);
+        fprintf(out, "%s_bucket{le=\"%.6f\"} %lu\n", name, hist_upper(i) * 1e-6, count);
+    }
+    count += RELAXED_LOAD(hist->buckets[HIST_BUCKETS]);
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %lu\n", name, count);
+    fprintf(out, "%s_sum %.6f\n", name, RELAXED_LOAD(hist->sum_us) * 1e-6);
+    fprintf(out, "%s_count %lu\n", name, count);
+}
+
+static void write_metric(FILE *out, const char *name, const char *type, const char *help, long long value)
+{
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n%s %lld\n", name, help, name, type, name, value);
+}
+
+static void write_metrics(FILE *out)
+{
+    write_metric(out, "specsem_workers_connected", "gauge",
+            "Workers that completed the handshake and are still connected.",
+            RELAXED_LOAD(workers_connected));
+    write_metric(out, "specsem_chunks_in_flight", "gauge",
+            "Chunks sent to workers and not answered yet.", RELAXED_LOAD(chunks_in_flight));
+    write_metric(out, "specsem_chunks_completed_total", "counter",
+            "Answered chunks.", RELAXED_LOAD(chunks_completed));
+    write_metric(out, "specsem_bytes_sent_total", "counter",
+            "Task bytes sent to workers.", RELAXED_LOAD(bytes_sent));
+    write_metric(out, "specsem_bytes_received_total", "counter",
+            "Bytes received from workers.", RELAXED_LOAD(bytes_received));
+    write_metric(out, "specsem_worker_reconnects_total", "counter",
+            "Workers that joined after the computation had started.", RELAXED_LOAD(worker_reconnects));
+    write_metric(out, "specsem_worker_disconnects_total", "counter",
+            "Workers that left or were closed.", RELAXED_LOAD(worker_disconnects));
+
+    static const char *const per_worker[][2] = {
+        { "specsem_worker_cores", "gauge" },
+        { "specsem_worker_chunks_in_flight", "gauge" },
+        { "specsem_worker_chunks_completed_total", "counter" },
+    };
+    for (size_t m = 0; m < sizeof(per_worker) / sizeof(per_worker[0]); ++m) {
+        fprintf(out, "# TYPE %s %s\n", per_worker[m][0], per_worker[m][1]);
+        for (size_t i = 0; i < METRICS_MAX_WORKERS; ++i) {
+            struct metrics_worker *worker = &workers[i];
+            if (!RELAXED_LOAD(worker->up))
+                continue;
+            unsigned long long value = m == 0 ? (unsigned long long)RELAXED_LOAD(worker->cores)
+                : m == 1 ? RELAXED_LOAD(worker->in_flight) : RELAXED_LOAD(worker->completed);
+            fprintf(out, "%s{worker=\"%zu\"} %llu\n", per_worker[m][0], i, value);
+        }
+    }
+
+    write_hist(out, "specsem_chunk_rtt_seconds",
+            "Time from sending a chunk to receiving its answer.", &rtt_hist);
+    write_hist(out, "specsem_chunk_compute_seconds",
+            "Chunk compute time reported by workers.", &compute_hist);
+}
+
+//================
+// Поток метрик
+//================
+static int listen_fd = -1;
+static int stop_fd = -1;
+static pthread_t metrics_tid;
+static char unix_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static bool send_all(int fd, const char *data, size_t size)
+{
+    while (size) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return false;
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Ответ на один запрос: содержимое запроса не разбирается, любой путь отдаёт метрики.
+static void metrics_serve(int fd)
+{
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char request[1024];
+    size_t got = 0;
+    while (got < sizeof(request) - 1) {
+        ssize_t ret = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (ret <= 0)
+            break;
+        got += ret;
+        request[got] = '\0';
+        if (strstr(request, "\r\n\r\n"))
+            break;
+    }
+
+    char *body = NULL;
+    size_t body_size = 0;
+    FILE *out = open_memstream(&body, &body_size);
+    if (!out)
+        return;
+    write_metrics(out);
+    fclose(out);
+
+    char header[256];
+    int header_size = snprintf(header, sizeof(header),
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n", body_size);
+    if (send_all(fd, header, header_size))
+        send_all(fd, body, body_size);
+    free(body);
+}
+
+static void *metrics_thread(void *arg)
+{
+    (void)arg;
+    struct pollfd fds[2] = {
+        { .fd = listen_fd, .events = POLLIN },
+        { .fd = stop_fd, .events = POLLIN },
+    };
+    for (;;) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "[metrics_thread] Unable to poll()\n");
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                metrics_serve(fd);
+                close(fd);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int metrics_listen_unix(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[metrics_start] Unix socket path is too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    strcpy(unix_path, path);
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int metrics_listen_inet(const char *addr)
+{
+    char host[256] = "127.0.0.1";
+    const char *port = addr;
+    const char *colon = strrchr(addr, ':');
+    if (colon) {
+        size_t len = colon - addr;
+        if (len >= sizeof(host))
+            return -1;
+        memcpy(host, addr, len);
+        host[len] = '\0';
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE };
+    struct addrinfo *res;
+    if (getaddrinfo(host, port, &hints, &res))
+        return -1;
+
+    int fd = socket(res->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int setsockopt_yes = 1;
+    if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &setsockopt_yes, sizeof(setsockopt_yes)) == -1 ||
+            bind(fd, res->ai_addr, res->ai_addrlen) == -1) {
+        if (fd != -1)
+            close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int metrics_start(const char *addr)
+{
+    if (!addr || metrics_enabled)
+        return -1;
+
+    unix_path[0] = '\0';
+    listen_fd = strncmp(addr, "unix:", 5) == 0 ? metrics_listen_unix(addr + 5) : metrics_listen_inet(addr);
+    if (listen_fd == -1 || listen(listen_fd, 16) == -1) {
+        fprintf(stderr, "[metrics_start] Unable to listen on %s\n", addr);
+        goto error;
+    }
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd == -1)
+        goto error;
+
+    // Измерения предыдущего запуска не относятся к новым соединениям.
+    for (size_t i = 0; i < METRICS_MAX_WORKERS; ++i)
+        atomic_store_explicit(&workers[i].up, false, memory_order_relaxed);
+    atomic_store_explicit(&workers_connected, 0, memory_order_relaxed);
+    atomic_store_explicit(&chunks_in_flight, 0, memory_order_relaxed);
+
+    metrics_enabled = true;
+    if (pthread_create(&metrics_tid, NULL, metrics_thread, NULL)) {
+        metrics_enabled = false;
+        goto error;
+    }
+    return 0;
+error:
+    if (listen_fd != -1)
+        close(listen_fd);
+    if (stop_fd != -1)
+        close(stop_fd);
+    listen_fd = stop_fd = -1;
+    if (unix_path[0])
+        unlink(unix_path);
+    return -1;
+}
+
+void metrics_stop(void)
+{
+    if (!metrics_enabled)
+        return;
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr, "[metrics_stop] Unable to wake metrics thread\n");
+    pthread_join(metrics_tid, NULL);
+    metrics_enabled = false;
+    close(listen_fd);
+    close(stop_fd);
+    listen_fd = stop_fd = -1;
+    if (unix_path[0])
+        unlink(unix_path);
+}
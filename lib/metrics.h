@@ -0,0 +1,54 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+//================
+// Метрики Управляющего узла в текстовом формате Prometheus.
+//================
+// Цикл Управляющего узла обновляет счётчики атомарными операциями с memory_order_relaxed
+// без блокировок; отдельный поток отдаёт их по HTTP (GET /metrics на любом пути)
+// на адресе "host:port" или Unix-сокете "unix:/path".
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Рабочие узлы с номером соединения не меньше этого учитываются только в общих метриках.
+#define METRICS_MAX_WORKERS 1024
+
+//! Метрики одного рабочего узла.
+struct metrics_worker;
+
+// Флаг включения метрик; проверяется перед любым обновлением.
+extern bool metrics_enabled;
+
+/*!
+ * \brief Функция для запуска потока, отдающего метрики.
+ *
+ * \param[in] addr "host:port", "port" (на 127.0.0.1) или "unix:/path".
+ *
+ * \return 0 в случае успеха, -1 при ошибке (метрики остаются выключенными).
+ */
+int metrics_start(const char *addr);
+
+// Остановка потока метрик и закрытие сокета; значения счётчиков сохраняются.
+void metrics_stop(void);
+
+// Время для измерения длительности задачи (0, если метрики выключены).
+uint64_t metrics_now_ns(void);
+
+// Подключение рабочего узла с номером соединения conn_i; NULL, если метрики выключены
+// или номер не меньше METRICS_MAX_WORKERS.
+struct metrics_worker *metrics_worker_up(size_t conn_i, int n_cores, bool late);
+
+// Отключение рабочего узла; его выданные задачи больше не считаются выполняемыми.
+void metrics_worker_down(struct metrics_worker *worker, uint32_t num_in_flight);
+
+// Задача отправлена рабочему узлу.
+void metrics_task_sent(struct metrics_worker *worker, size_t bytes);
+
+// Получен ответ на задачу, отправленную в sent_ns; compute_us - время вычисления по данным узла.
+void metrics_task_done(struct metrics_worker *worker, uint64_t sent_ns, uint32_t compute_us);
+
+// Получены данные от рабочих узлов.
+void metrics_bytes_received(size_t bytes);
+
+#endif // METRICS_H
@@ -0,0 +1,165 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "profile.h"
+#include "quad.h"
+
+// Имена функций FUNC_TABLE в файле профиля.
+static const char *const profile_names[NOT_SUPPORT] = { "exp", "sin", "sqr" };
+
+// Точек в одном вызове ядра при калибровке.
+#define PROFILE_BLOCK 65536
+// Вызовов ядра на отрезок калибровки.
+#define PROFILE_BLOCKS 16
+
+// Длина отрезка калибровки: стоимость sin зависит от порядка аргумента, поэтому отрезок
+// охватывает аргументы до 10^6, как у реальных заданий; для exp - без переполнения.
+static const double calibrate_length[NOT_SUPPORT] = { 512, 1048576, 1048576 };
+
+const char *profile_path(void)
+{
+    static char path[PATH_MAX];
+    const char *env = getenv("SPECSEM_PROFILE");
+    if (env)
+        return env;
+
+    char host[HOST_NAME_MAX + 1] = "localhost";
+    gethostname(host, sizeof(host));
+    host[HOST_NAME_MAX] = '\0';
+    const char *home = getenv("HOME");
+    snprintf(path, sizeof(path), "%s%s.specsem_profile.%s", home ? home : "", home ? "/" : "", host);
+    return path;
+}
+
+int profile_load(const char *path, double evals_per_sec[NOT_SUPPORT])
+{
+    for (int i = 0; i < NOT_SUPPORT; ++i)
+        evals_per_sec[i] = 0;
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return -1;
+
+    char line[256];
+    char name[32];
+    double value;
+    int num_loaded = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || sscanf(line, "%31s %lf", name, &value) != 2)
+            continue;
+        for (int i = 0; i < NOT_SUPPORT; ++i) {
+            if (!strcmp(name, profile_names[i]) && isfinite(value) && value > 0) {
+                evals_per_sec[i] = value;
+                ++num_loaded;
+            }
+        }
+    }
+    fclose(file);
+    if (!num_loaded) {
+        fprintf(stderr, "[profile_load] No functions in profile %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int profile_save(const char *path, const double evals_per_sec[NOT_SUPPORT], int n_cores)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "[profile_save] Unable to open %s\n", path);
+        return -1;
+    }
+    char host[HOST_NAME_MAX + 1] = "localhost";
+    gethostname(host, sizeof(host));
+    host[HOST_NAME_MAX] = '\0';
+    fprintf(file, "# SpecSem profile: %s, %d cores, evaluations per second per core\n", host, n_cores);
+    for (int i = 0; i < NOT_SUPPORT; ++i)
+        fprintf(file, "%s %.6e\n", profile_names[i], evals_per_sec[i]);
+    if (fclose(file)) {
+        fprintf(stderr, "[profile_save] Unable to write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+//================
+// Калибровка
+//================
+
+struct calibrate_arg {
+    FUNC_TABLE func;
+    double evals_per_sec;
+};
+
+static double calibrate_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *calibrate_thread(void *arg)
+{
+    struct calibrate_arg *calibrate = arg;
+    // Результат сохраняется, чтобы вызов ядра не был удалён оптимизатором.
+    volatile double sink = 0;
+    uint64_t calls = 0;
+    double step = calibrate_length[calibrate->func] / PROFILE_BLOCKS / PROFILE_BLOCK;
+    double start = calibrate_now();
+    double elapsed;
+    do {
+        double left = 1 + (calls % PROFILE_BLOCKS) * PROFILE_BLOCK * step;
+        sink = sink + quad_midpoint(calibrate->func, left, step, PROFILE_BLOCK);
+        ++calls;
+        elapsed = calibrate_now() - start;
+    } while (elapsed * 1000 < PROFILE_CALIBRATE_MS);
+    calibrate->evals_per_sec = calls * PROFILE_BLOCK / elapsed;
+    return NULL;
+}
+
+int profile_calibrate(int n_cores, double evals_per_sec[NOT_SUPPORT])
+{
+    if (n_cores <= 0)
+        return -1;
+
+    pthread_t *threads = calloc(n_cores, sizeof(*threads));
+    struct calibrate_arg *args = calloc(n_cores, sizeof(*args));
+    if (!threads || !args) {
+        fprintf(stderr, "[profile_calibrate] Unable to allocate memory\n");
+        free(threads);
+        free(args);
+        return -1;
+    }
+
+    int ret = 0;
+    for (int func = 0; func < NOT_SUPPORT && !ret; ++func) {
+        // Все ядра нагружены одновременно; запуск потоков много короче измерения.
+        int num_started = 0;
+        for (; num_started < n_cores; ++num_started) {
+            args[num_started] = (struct calibrate_arg){ .func = func };
+            if (pthread_create(&threads[num_started], NULL, calibrate_thread, &args[num_started])) {
+                fprintf(stderr, "[profile_calibrate] Unable to create thread\n");
+                ret = -1;
+                break;
+            }
+        }
+        for (int i = 0; i < num_started; ++i)
+            pthread_join(threads[i], NULL);
+
+        double sum = 0;
+        for (int i = 0; i < num_started; ++i)
+            sum += args[i].evals_per_sec;
+        evals_per_sec[func] = num_started ? sum / num_started : 0;
+    }
+    free(threads);
+    free(args);
+    return ret;
+}
@@ -0,0 +1,40 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+//================
+// Профиль производительности узла: калибровка ядер и хранение результата.
+//================
+// Профиль - количество вычислений каждой функции FUNC_TABLE в секунду на одно ядро.
+// Он измеряется один раз на узле и хранится в локальном текстовом файле: строка
+// комментария и строки "<функция> <вычислений в секунду>"; функции, которых нет
+// в файле, считаются неизмеренными (0).
+#include "common.h"
+
+//! Время измерения одной функции при калибровке в миллисекундах.
+#define PROFILE_CALIBRATE_MS 300
+
+//! Путь к файлу профиля: переменная окружения SPECSEM_PROFILE либо ~/.specsem_profile.<имя узла>
+//! (в текущем каталоге, если HOME не задан). Возвращает статический буфер.
+const char *profile_path(void);
+
+//! Загрузка профиля; 0 в случае успеха, -1, если файла нет или в нём нет ни одной функции.
+int profile_load(const char *path, double evals_per_sec[NOT_SUPPORT]);
+
+//! Сохранение профиля, измеренного на n_cores ядрах; 0 в случае успеха, -1 при ошибке.
+int profile_save(const char *path, const double evals_per_sec[NOT_SUPPORT], int n_cores);
+
+/*!
+ * \brief Функция для калибровки ядер вычислений.
+ *
+ * \param[in] n_cores Количество одновременно нагруженных ядер.
+ * \param[out] evals_per_sec Вычислений каждой функции в секунду на одно ядро.
+ *
+ * \return 0 в случае успеха, -1 при ошибке.
+ *
+ * \details Каждая функция считается quad_midpoint в n_cores потоках одновременно около
+ *          PROFILE_CALIBRATE_MS, поэтому в профиль входят общая частота и кэш всех ядер,
+ *          как при распределённом вычислении. Результат - среднее по потокам.
+ */
+int profile_calibrate(int n_cores, double evals_per_sec[NOT_SUPPORT]);
+
+#endif // PROFILE_H
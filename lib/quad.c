@@ -0,0 +1,393 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "quad.h"
+#include "worker.h"
+
+double func_eval(FUNC_TABLE func, double x)
+{
+    switch (func) {
+    case EXP:
+        return exp(x);
+    case SIN:
+        return sin(x);
+    case SQR:
+        return x * x;
+    default:
+        return NAN;
+    }
+}
+
+double func_max_ddf(FUNC_TABLE func, double left, double right)
+{
+    switch (func) {
+    case EXP:
+        return exp(fmax(left, right));
+    case SIN:
+        return 1;
+    case SQR:
+        return 2;
+    default:
+        return NAN;
+    }
+}
+
+uint64_t quad_num_steps(FUNC_TABLE func, double left, double right, double tolerance)
+{
+    if (func >= NOT_SUPPORT || !(tolerance > 0))
+        return 0;
+
+    double length = fabs(right - left);
+    double max_ddf = func_max_ddf(func, left, right);
+    if (length == 0 || max_ddf == 0)
+        return 1;
+
+    double step = sqrt(24 * tolerance / (length * max_ddf));
+    double steps = ceil(length / step);
+    if (!(steps < 0x1.0p63))
+        return 0;
+    return steps < 1 ? 1 : (uint64_t)steps;
+}
+
+double quad_midpoint(FUNC_TABLE func, double left, double step, uint64_t parts)
+{
+    double result = 0;
+    double x;
+
+    // Между блоками проверяется токен отмены.
+    for (uint64_t begin = 0; begin < parts; begin += WORKER_CANCEL_BLOCK) {
+        uint64_t end = parts - begin > WORKER_CANCEL_BLOCK ? begin + WORKER_CANCEL_BLOCK : parts;
+        if (begin && worker_cancelled())
+            return NAN;
+
+        // Точка пересчитывается от левой границы, чтобы не накапливать ошибку округления шага.
+        switch (func) {
+        case EXP:
+            for (uint64_t i = begin; i < end; ++i) {
+                x = left + (i + 0.5) * step;
+                result += exp(x);
+            }
+            break;
+        case SIN:
+            for (uint64_t i = begin; i < end; ++i) {
+                x = left + (i + 0.5) * step;
+                result += sin(x);
+            }
+            break;
+        case SQR:
+            for (uint64_t i = begin; i < end; ++i) {
+                x = left + (i + 0.5) * step;
+                result += x * x;
+            }
+            break;
+        default:
+            return NAN;
+        }
+    }
+    return result * step;
+}
+
+// Сумма значений в count точках с номерами first, first + spacing, ...
+static double midpoint_sum(FUNC_TABLE func, double left, double step, uint64_t first, uint64_t spacing,
+        uint64_t count)
+{
+    double result = 0;
+    double x;
+    uint64_t end = first + count * spacing;
+
+    switch (func) {
+    case EXP:
+        for (uint64_t i = first; i < end; i += spacing) {
+            x = left + (i + 0.5) * step;
+            result += exp(x);
+        }
+        break;
+    case SIN:
+        for (uint64_t i = first; i < end; i += spacing) {
+            x = left + (i + 0.5) * step;
+            result += sin(x);
+        }
+        break;
+    case SQR:
+        for (uint64_t i = first; i < end; i += spacing) {
+            x = left + (i + 0.5) * step;
+            result += x * x;
+        }
+        break;
+    default:
+        return NAN;
+    }
+    return result;
+}
+
+double quad_midpoint_anytime(FUNC_TABLE func, double left, double step, uint64_t parts)
+{
+    if (func >= NOT_SUPPORT)
+        return NAN;
+    if (!parts)
+        return 0;
+
+    uint64_t stride = 1;
+    while (stride * 2 * QUAD_ANYTIME_COARSE <= parts)
+        stride *= 2;
+
+    double length = parts * step;
+    double sum = 0;
+    uint64_t count = 0;
+    double estimate = 0;
+    double error = INFINITY;
+    // Уровень 0 - точки, кратные stride; следующие уровни - нечётные кратные stride / 2^level.
+    uint64_t first = 0;
+    uint64_t spacing = stride;
+    for (;;) {
+        uint64_t points = first < parts ? (parts - first - 1) / spacing + 1 : 0;
+        for (uint64_t done = 0; done < points; done += WORKER_CANCEL_BLOCK) {
+            uint64_t block = points - done > WORKER_CANCEL_BLOCK ? WORKER_CANCEL_BLOCK : points - done;
+            if (count && worker_cancelled())
+                return NAN;
+            sum += midpoint_sum(func, left, step, first + done * spacing, spacing, block);
+            count += block;
+            worker_partial(estimate, error, (double)count / parts);
+        }
+
+        double level = length * sum / count;
+        error = first ? fabs(level - estimate) : INFINITY;
+        estimate = level;
+        worker_partial(estimate, error, (double)count / parts);
+        if (stride == 1)
+            break;
+        stride /= 2;
+        first = stride;
+        spacing = 2 * stride;
+    }
+    return sum * step;
+}
+
+double func_period(FUNC_TABLE func)
+{
+    return func == SIN ? 2 * M_PI : 0;
+}
+
+// Интеграл func по [left, right] через первообразную; формы выбраны так, чтобы
+// не терять точность на коротких отрезках.
+static double func_integral(FUNC_TABLE func, double left, double right)
+{
+    switch (func) {
+    case EXP:
+        return exp(left) * expm1(right - left);
+    case SIN:
+        return 2 * sin((left + right) / 2) * sin((right - left) / 2);
+    case SQR:
+        return (right - left) * (left * left + left * right + right * right) / 3;
+    default:
+        return NAN;
+    }
+}
+
+int quad_plan(FUNC_TABLE func, double left, double right, unsigned flags, QUAD_PLAN *plan)
+{
+    plan->known = 0;
+    plan->left = left;
+    plan->right = right;
+    if (func >= NOT_SUPPORT)
+        return -1;
+
+    if (flags & QUAD_PLAN_ANALYTIC) {
+        plan->known = func_integral(func, left, right);
+        plan->right = left;
+        return 0;
+    }
+
+    double period = func_period(func);
+    if ((flags & QUAD_PLAN_PERIODIC) && period > 0) {
+        // Отбрасываются целые периоды у правой границы; интеграл по ним равен нулю.
+        double periods = trunc((right - left) / period);
+        plan->right = right - periods * period;
+    }
+    return 0;
+}
+
+unsigned quad_plan_parse(const char *mode)
+{
+    if (!mode || !strcmp(mode, "none"))
+        return 0;
+    if (!strcmp(mode, "periodic"))
+        return QUAD_PLAN_PERIODIC;
+    if (!strcmp(mode, "analytic"))
+        return QUAD_PLAN_PERIODIC | QUAD_PLAN_ANALYTIC;
+    fprintf(stderr, "[quad_plan_parse] Unknown mode %s\n", mode);
+    return 0;
+}
+
+double func_max_d4f(FUNC_TABLE func, double left, double right)
+{
+    switch (func) {
+    case EXP:
+        return exp(fmax(left, right));
+    case SIN:
+        return 1;
+    case SQR:
+        return 0;
+    default:
+        return NAN;
+    }
+}
+
+double quad_simpson(FUNC_TABLE func, double left, double step, uint64_t parts)
+{
+    if (func >= NOT_SUPPORT)
+        return NAN;
+    if (!parts)
+        return 0;
+
+    // Середины отрезков входят в сумму с весом 4, правые концы - с весом 2 (последний
+    // вычитается ниже): один проход на блок, как в quad_midpoint.
+    double mids = 0;
+    double nodes = 0;
+    for (uint64_t begin = 0; begin < parts; begin += WORKER_CANCEL_BLOCK) {
+        uint64_t end = parts - begin > WORKER_CANCEL_BLOCK ? begin + WORKER_CANCEL_BLOCK : parts;
+        if (begin && worker_cancelled())
+            return NAN;
+
+        switch (func) {
+        case EXP:
+            for (uint64_t i = begin; i < end; ++i) {
+                mids += exp(left + (i + 0.5) * step);
+                nodes += exp(left + (i + 1) * step);
+            }
+            break;
+        case SIN:
+            for (uint64_t i = begin; i < end; ++i) {
+                mids += sin(left + (i + 0.5) * step);
+                nodes += sin(left + (i + 1) * step);
+            }
+            break;
+        case SQR:
+            for (uint64_t i = begin; i < end; ++i) {
+                double x = left + (i + 0.5) * step;
+                double y = left + (i + 1) * step;
+                mids += x * x;
+                nodes += y * y;
+            }
+            break;
+        default:
+            return NAN;
+        }
+    }
+    double right = func_eval(func, left + parts * step);
+    return (func_eval(func, left) - right + 4 * mids + 2 * nodes) * step / 6;
+}
+
+// Количество шагов формулы rule, при котором остаточный член не превышает tolerance
+// (0 - шагов слишком много).
+static uint64_t rule_num_steps(QUAD_RULE rule, FUNC_TABLE func, double left, double right, double tolerance)
+{
+    if (rule == QUAD_RULE_MIDPOINT)
+        return quad_num_steps(func, left, right, tolerance);
+
+    double length = fabs(right - left);
+    double max_d4f = func_max_d4f(func, left, right);
+    if (length == 0 || max_d4f == 0)
+        return 1;
+
+    double step = pow(2880 * tolerance / (length * max_d4f), 0.25);
+    double steps = ceil(length / step);
+    if (!(steps < 0x1.0p63))
+        return 0;
+    return steps < 1 ? 1 : (uint64_t)steps;
+}
+
+// Остаточный член формулы rule при num_steps шагах.
+static double rule_tolerance(QUAD_RULE rule, FUNC_TABLE func, double left, double right, uint64_t num_steps)
+{
+    double length = fabs(right - left);
+    double step = length / num_steps;
+    if (rule == QUAD_RULE_MIDPOINT)
+        return length * step * step * func_max_ddf(func, left, right) / 24;
+    return length * pow(step, 4) * func_max_d4f(func, left, right) / 2880;
+}
+
+static double rule_evals(QUAD_RULE rule, uint64_t num_steps)
+{
+    return rule == QUAD_RULE_SIMPSON ? 2.0 * num_steps + 1 : (double)num_steps;
+}
+
+// Формула с наименьшим числом вычислений для погрешности tolerance.
+static bool cost_pick(FUNC_TABLE func, double left, double right, double tolerance, QUAD_COST_PLAN *plan)
+{
+    plan->num_steps = 0;
+    for (QUAD_RULE rule = QUAD_RULE_MIDPOINT; rule <= QUAD_RULE_SIMPSON; ++rule) {
+        uint64_t num_steps = rule_num_steps(rule, func, left, right, tolerance);
+        if (num_steps && (!plan->num_steps || rule_evals(rule, num_steps) < plan->evals)) {
+            plan->rule = rule;
+            plan->num_steps = num_steps;
+            plan->evals = rule_evals(rule, num_steps);
+        }
+    }
+    return plan->num_steps != 0;
+}
+
+int quad_cost_plan(FUNC_TABLE func, double left, double right, double tolerance, double max_tolerance,
+        const QUAD_COST_BUDGET *budget, size_t tasks_per_node, QUAD_COST_PLAN *plan)
+{
+    memset(plan, 0, sizeof(*plan));
+    plan->status = QUAD_COST_REJECTED;
+    if (func >= NOT_SUPPORT || !(tolerance > 0) || !budget)
+        return -1;
+    if (!cost_pick(func, left, right, tolerance, plan))
+        return -1;
+
+    double rate = budget->evals_per_sec;
+    double max_evals = rate * budget->seconds * QUAD_COST_MARGIN;
+    if (!(rate > 0)) {
+        plan->status = QUAD_COST_UNKNOWN;
+    } else if (plan->evals <= max_evals) {
+        plan->status = QUAD_COST_OK;
+    } else {
+        // Лучшая точность, достижимая за max_evals вычислений.
+        QUAD_RULE best_rule = QUAD_RULE_MIDPOINT;
+        uint64_t best_steps = 0;
+        double best = INFINITY;
+        for (QUAD_RULE rule = QUAD_RULE_MIDPOINT; rule <= QUAD_RULE_SIMPSON; ++rule) {
+            double steps = floor(rule == QUAD_RULE_SIMPSON ? (max_evals - 1) / 2 : max_evals);
+            if (steps < 1)
+                continue;
+            double achieved = rule_tolerance(rule, func, left, right, (uint64_t)steps);
+            if (achieved < best) {
+                best = achieved;
+                best_rule = rule;
+                best_steps = (uint64_t)steps;
+            }
+        }
+        if (!best_steps || !(best <= max_tolerance)) {
+            // План для худшей допустимой точности показывает, насколько задание не успевает.
+            if (max_tolerance > tolerance)
+                cost_pick(func, left, right, max_tolerance, plan);
+            plan->tolerance = rule_tolerance(plan->rule, func, left, right, plan->num_steps);
+            plan->seconds = plan->evals / rate;
+            return -1;
+        }
+        plan->status = QUAD_COST_DOWNGRADED;
+        plan->rule = best_rule;
+        plan->num_steps = best_steps;
+        plan->evals = rule_evals(best_rule, best_steps);
+    }
+    plan->step = (right - left) / plan->num_steps;
+    plan->tolerance = rule_tolerance(plan->rule, func, left, right, plan->num_steps);
+    plan->seconds = rate > 0 ? plan->evals / rate : 0;
+
+    // Не больше tasks_per_node задач на узел, и каждая не короче QUAD_COST_MIN_TASK_SEC.
+    size_t num_nodes = budget->num_nodes ? budget->num_nodes : 1;
+    size_t per_node = tasks_per_node ? tasks_per_node : 1;
+    if (plan->seconds > 0 && plan->seconds / QUAD_COST_MIN_TASK_SEC < per_node) {
+        double fit = floor(plan->seconds / QUAD_COST_MIN_TASK_SEC);
+        per_node = fit < 1 ? 1 : (size_t)fit;
+    }
+    plan->num_tasks = per_node * num_nodes;
+    if (plan->num_tasks > plan->num_steps)
+        plan->num_tasks = plan->num_steps;
+    return 0;
+}
@@ -0,0 +1,193 @@
+#ifndef QUAD_H
+#define QUAD_H
+
+//================
+// Квадратурные ядра для встроенных функций FUNC_TABLE.
+//================
+#include <stdint.h>
+
+#include "common.h"
+
+//! Значение функции func в точке x.
+double func_eval(FUNC_TABLE func, double x);
+
+//! Верхняя оценка |f''(x)| на отрезке [left, right].
+double func_max_ddf(FUNC_TABLE func, double left, double right);
+
+/*!
+ * \brief Функция для выбора числа шагов метода средних прямоугольников.
+ *
+ * \return Количество шагов, при котором остаточный член (b - a) h^2 max|f''| / 24
+ *         не превышает tolerance (не меньше 1), либо 0 при некорректных аргументах.
+ */
+uint64_t quad_num_steps(FUNC_TABLE func, double left, double right, double tolerance);
+
+/*!
+ * \brief Функция для вычисления интеграла методом средних прямоугольников.
+ *
+ * \param[in] func Подынтегральная функция.
+ * \param[in] left Левая граница.
+ * \param[in] step Шаг.
+ * \param[in] parts Количество шагов.
+ *
+ * \details Выбор функции вынесен из цикла, поэтому каждая функция считается
+ *          отдельным плотным циклом. Между блоками по WORKER_CANCEL_BLOCK шагов проверяется
+ *          токен отмены; при отмене возвращается NAN.
+ */
+double quad_midpoint(FUNC_TABLE func, double left, double step, uint64_t parts);
+
+/*!
+ * \brief Функция для вычисления интеграла составным методом Симпсона.
+ *
+ * \param[in] parts Количество отрезков длины step; на каждом функция вычисляется в концах
+ *            и середине, общие концы соседних отрезков - один раз (2 * parts + 1 вычислений).
+ *
+ * \details Отмена проверяется так же, как в quad_midpoint; при отмене возвращается NAN.
+ */
+double quad_simpson(FUNC_TABLE func, double left, double step, uint64_t parts);
+
+//! Верхняя оценка |f''''(x)| на отрезке [left, right].
+double func_max_d4f(FUNC_TABLE func, double left, double right);
+
+//! Количество точек грубого уровня quad_midpoint_anytime.
+#define QUAD_ANYTIME_COARSE 1024
+
+/*!
+ * \brief Функция для вычисления интеграла методом средних прямоугольников с промежуточными оценками.
+ *
+ * \details Результат совпадает с quad_midpoint (с точностью до порядка суммирования), но точки
+ *          обходятся от грубого уровня к мелким: сначала каждая stride-я точка (не меньше
+ *          QUAD_ANYTIME_COARSE точек), затем на каждом уровне добавляются середины между уже
+ *          вычисленными. После уровня интеграл оценивается как длина отрезка, умноженная на среднее
+ *          значение в вычисленных точках, погрешность - как разность оценок двух последних уровней.
+ *          Оценка и доля вычисленных точек передаются worker_partial после каждого блока.
+ */
+double quad_midpoint_anytime(FUNC_TABLE func, double left, double step, uint64_t parts);
+
+//================
+// Планирование: упрощение интеграла до распределения задач.
+//================
+
+//! Разрешённые упрощения
+typedef enum
+{
+    // Свёртка периодической функции: целые периоды не вычисляются.
+    QUAD_PLAN_PERIODIC = 1 << 0,
+    // Значение по первообразной в замкнутой форме.
+    QUAD_PLAN_ANALYTIC = 1 << 1,
+} QUAD_PLAN_FLAGS;
+
+//! Результат планирования интеграла по [left, right]
+typedef struct
+{
+    // Часть интеграла, найденная без численного интегрирования.
+    double known;
+    // Отрезок, который остаётся проинтегрировать численно (пустой, если left == right).
+    double left;
+    double right;
+} QUAD_PLAN;
+
+//! Период функции (0 - функция непериодическая).
+double func_period(FUNC_TABLE func);
+
+/*!
+ * \brief Функция для упрощения интеграла перед распределением задач.
+ *
+ * \param[in] flags Разрешённые упрощения (QUAD_PLAN_FLAGS).
+ * \param[out] plan Известная часть интеграла и остаток для численного интегрирования.
+ *
+ * \return 0 в случае успеха, -1 для неподдерживаемой функции.
+ *
+ * \details При QUAD_PLAN_ANALYTIC интеграл вычисляется по первообразной и остаток пуст.
+ *          При QUAD_PLAN_PERIODIC отрезок периодической функции укорачивается на целое
+ *          число периодов; интеграл sin по периоду равен нулю, поэтому остаток не длиннее периода.
+ *          Итоговый интеграл равен known плюс численный интеграл по остатку.
+ */
+int quad_plan(FUNC_TABLE func, double left, double right, unsigned flags, QUAD_PLAN *plan);
+
+//! Разбор режима планирования: "periodic", "analytic" (вместе со свёрткой) или "none"/NULL.
+unsigned quad_plan_parse(const char *mode);
+
+//================
+// Планирование по стоимости: выбор метода и разбиения по производительности узлов.
+//================
+
+//! Квадратурные формулы
+typedef enum
+{
+    // Метод средних прямоугольников (quad_midpoint): одно вычисление на шаг.
+    QUAD_RULE_MIDPOINT,
+    // Составной метод Симпсона (quad_simpson): два вычисления на шаг, погрешность O(h^4).
+    QUAD_RULE_SIMPSON,
+} QUAD_RULE;
+
+//! Решение планировщика
+typedef enum
+{
+    // Задание успевает с запрошенной точностью.
+    QUAD_COST_OK,
+    // Точность понижена, чтобы задание успело.
+    QUAD_COST_DOWNGRADED,
+    // Производительность узлов неизвестна: взята запрошенная точность без прогноза времени.
+    QUAD_COST_UNKNOWN,
+    // Задание не успевает даже с худшей допустимой точностью.
+    QUAD_COST_REJECTED,
+} QUAD_COST_STATUS;
+
+// Доля оставшегося времени, на которую рассчитывается задание: запас на обмен с узлами
+// и неравномерную загрузку в конце.
+#define QUAD_COST_MARGIN 0.8
+// Наименьшая длительность задачи на среднем узле в секундах: более мелкие задачи
+// не окупают обмен с Управляющим узлом.
+#define QUAD_COST_MIN_TASK_SEC 0.05
+
+//! Ресурсы для задания
+typedef struct
+{
+    // Суммарное количество вычислений функции в секунду по всем узлам (0 - неизвестно).
+    double evals_per_sec;
+    // Количество рабочих узлов.
+    size_t num_nodes;
+    // Время, за которое задание должно выполниться, в секундах.
+    double seconds;
+} QUAD_COST_BUDGET;
+
+//! План вычисления интеграла
+typedef struct
+{
+    QUAD_COST_STATUS status;
+    QUAD_RULE rule;
+    // Шаг и количество шагов выбранной формулы.
+    double step;
+    uint64_t num_steps;
+    // Оценка погрешности по остаточному члену.
+    double tolerance;
+    // Количество вычислений функции и прогноз времени в секундах (0, если производительность неизвестна).
+    double evals;
+    double seconds;
+    // Количество задач.
+    size_t num_tasks;
+} QUAD_COST_PLAN;
+
+/*!
+ * \brief Функция для выбора формулы, шага и разбиения на задачи по прогнозу времени.
+ *
+ * \param[in] tolerance Запрошенная погрешность интеграла.
+ * \param[in] max_tolerance Худшая допустимая погрешность при понижении точности
+ *            (не больше tolerance - понижение запрещено).
+ * \param[in] budget Производительность узлов и время на задание.
+ * \param[in] tasks_per_node Желаемое количество задач на узел.
+ * \param[out] plan План; при QUAD_COST_REJECTED заполнен для худшей допустимой точности.
+ *
+ * \return 0 в случае успеха, -1, если задание отклонено или аргументы некорректны.
+ *
+ * \details Для каждой формулы количество шагов выбирается по остаточному члену, и берётся формула
+ *          с меньшим числом вычислений. Если прогноз превышает QUAD_COST_MARGIN от budget->seconds,
+ *          точность понижается до той, что достижима за это время лучшей формулой, но не хуже
+ *          max_tolerance. Задач не больше tasks_per_node на узел и не короче QUAD_COST_MIN_TASK_SEC
+ *          на среднем узле (хотя бы одна на узел, если шагов хватает).
+ */
+int quad_cost_plan(FUNC_TABLE func, double left, double right, double tolerance, double max_tolerance,
+        const QUAD_COST_BUDGET *budget, size_t tasks_per_node, QUAD_COST_PLAN *plan);
+
+#endif // QUAD_H
@@ -0,0 +1,78 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#include "record.h"
+
+// Буфер файла записи: события пишутся в память и сбрасываются крупными блоками.
+#define RECORD_BUFFER_SIZE (1 << 16)
+
+_Atomic bool record_enabled = false;
+
+static FILE *record_file = NULL;
+static uint64_t record_start_ns = 0;
+
+static uint64_t record_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int record_open(const char *path)
+{
+    if (record_file)
+        return -1;
+    record_file = fopen(path, "wb");
+    if (!record_file) {
+        fprintf(stderr, "[record_open] Unable to open %s\n", path);
+        return -1;
+    }
+    setvbuf(record_file, NULL, _IOFBF, RECORD_BUFFER_SIZE);
+
+    struct record_header header = { .event_size = sizeof(struct record_event) };
+    memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, record_file) != 1) {
+        fprintf(stderr, "[record_open] Unable to write %s\n", path);
+        fclose(record_file);
+        record_file = NULL;
+        return -1;
+    }
+    record_start_ns = record_now_ns();
+    atomic_store(&record_enabled, true);
+    return 0;
+}
+
+void record_write(uint16_t type, uint32_t conn, uint16_t msg_type, uint32_t arg0, uint32_t arg1, uint64_t size)
+{
+    struct record_event event = {
+        .ts_ns = record_now_ns() - record_start_ns,
+        .conn = conn,
+        .type = type,
+        .msg_type = msg_type,
+        .arg0 = arg0,
+        .arg1 = arg1,
+        .size = size,
+    };
+    if (fwrite(&event, sizeof(event), 1, record_file) != 1) {
+        // Циклы других потоков увидят флаг при следующем событии.
+        if (atomic_exchange(&record_enabled, false))
+            fprintf(stderr, "[record_write] Unable to write event, recording stopped\n");
+    }
+}
+
+void record_close(void)
+{
+    if (!record_file)
+        return;
+    atomic_store(&record_enabled, false);
+    if (fclose(record_file))
+        fprintf(stderr, "[record_close] Unable to flush record file\n");
+    record_file = NULL;
+}
@@ -0,0 +1,72 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+//================
+// Запись событий протокола Управляющего узла для воспроизведения (replay).
+//================
+// Файл записи: заголовок record_header и события record_event фиксированного размера
+// в порядке их обработки циклами Управляющего узла (события одного соединения идут по порядку).
+// Содержимое задач и ответов не пишется, только размеры: для воспроизведения нагрузки
+// достаточно формы трафика.
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define RECORD_MAGIC "SSREC001"
+
+//! Типы событий записи
+typedef enum
+{
+    // Узел подключился.
+    RECORD_CONNECT = 1,
+    // Получены данные об узле: arg0 - ядра, arg1 - кредиты.
+    RECORD_INFO,
+    // Узлу отправлена задача размером size.
+    RECORD_TASK,
+    // От узла получено сообщение msg_type с size байт данных; arg0 - compute_us из заголовка.
+    RECORD_MESSAGE,
+    // Узел отключился или соединение разорвано из-за ошибки.
+    RECORD_DISCONNECT,
+    // Управляющий узел закрыл соединение: arg0 - 0 (задач больше нет) или 1 (отмена).
+    RECORD_CLOSE,
+} RECORD_TYPE;
+
+struct record_header {
+    char magic[8];
+    // Размер одного события (для проверки совместимости).
+    uint32_t event_size;
+    uint32_t reserved;
+};
+
+struct record_event {
+    // Время от начала записи в наносекундах.
+    uint64_t ts_ns;
+    // Номер соединения.
+    uint32_t conn;
+    uint16_t type;
+    uint16_t msg_type;
+    uint32_t arg0;
+    uint32_t arg1;
+    uint64_t size;
+};
+
+// Флаг включения записи; проверяется макросом RECORD перед любой записью. Атомарный:
+// при ошибке записи его сбрасывает цикл любого потока.
+extern _Atomic bool record_enabled;
+
+// Открытие файла записи; 0 в случае успеха, -1 при ошибке.
+int record_open(const char *path);
+
+// Запись одного события; вызывается из циклов Управляющего узла (запись в FILE атомарна).
+void record_write(uint16_t type, uint32_t conn, uint16_t msg_type, uint32_t arg0, uint32_t arg1, uint64_t size);
+
+// Сброс буфера и закрытие файла записи.
+void record_close(void);
+
+#define RECORD(...)                                                                           \
+    do {                                                                                      \
+        if (__builtin_expect(atomic_load_explicit(&record_enabled, memory_order_relaxed), 0)) \
+            record_write(__VA_ARGS__);                                                        \
+    } while (0)
+
+#endif // RECORD_H
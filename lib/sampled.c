@@ -0,0 +1,290 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sampled.h"
+
+// Одна выборка - пара (x, y).
+#define SAMPLE_SIZE (2 * sizeof(double))
+
+// Аргументы потока исполнителя: часть отображённого диапазона.
+struct sampled_thread {
+    size_t size_of_structure;
+    uint32_t rule;
+    // Выборки потока; соседние потоки имеют одну общую точку.
+    const double *samples;
+    uint64_t count;
+    // Результат потока.
+    double partial;
+    // Отображение файла (хранится в аргументах первого потока).
+    void *map_base;
+    size_t map_length;
+};
+
+// Количество интервалов в части part из parts; для формулы Симпсона - чётное, кроме последней.
+static uint64_t split_intervals(uint64_t intervals, uint64_t parts, uint64_t part, bool even)
+{
+    if (!even) {
+        return intervals / parts + (part < intervals % parts);
+    }
+    uint64_t pairs = intervals / 2;
+    uint64_t res = 2 * (pairs / parts + (part < pairs % parts));
+    if (part == parts - 1)
+        res += intervals % 2;
+    return res;
+}
+
+//=================================
+// Векторные ядра.
+//=================================
+// Используются векторные расширения GCC: четыре интервала за итерацию без привязки
+// к конкретному набору инструкций.
+
+typedef double v4df __attribute__((vector_size(32)));
+typedef int64_t v4di __attribute__((vector_size(32)));
+
+// Макросы вместо функций: передача 32-байтных векторов по значению зависит от ABI.
+#define LOAD4(v, p) memcpy(&(v), (p), sizeof(v4df))
+#define HSUM(v) (((v)[0] + (v)[1]) + ((v)[2] + (v)[3]))
+
+static double trapezoid(const double *s, uint64_t count)
+{
+    if (count < 2)
+        return 0;
+
+    uint64_t i = 0;
+    v4df acc = {};
+    if (count >= 6) {
+        v4df l0;
+        LOAD4(l0, s);
+        // Нужны точки i..i+5: последняя загрузка читает пару (i+4, i+5).
+        for (; i + 6 <= count; i += 4) {
+            v4df l1, l2;
+            LOAD4(l1, s + 2 * (i + 2));
+            LOAD4(l2, s + 2 * (i + 4));
+            v4df x0 = __builtin_shuffle(l0, l1, (v4di){ 0, 2, 4, 6 });
+            v4df y0 = __builtin_shuffle(l0, l1, (v4di){ 1, 3, 5, 7 });
+            v4df xn = __builtin_shuffle(l1, l2, (v4di){ 0, 2, 4, 6 });
+            v4df yn = __builtin_shuffle(l1, l2, (v4di){ 1, 3, 5, 7 });
+            v4df x1 = __builtin_shuffle(x0, xn, (v4di){ 1, 2, 3, 6 });
+            v4df y1 = __builtin_shuffle(y0, yn, (v4di){ 1, 2, 3, 6 });
+            acc += (x1 - x0) * (y0 + y1);
+            l0 = l2;
+        }
+    }
+
+    double result = HSUM(acc);
+    for (; i + 1 < count; ++i)
+        result += (s[2 * i + 2] - s[2 * i]) * (s[2 * i + 1] + s[2 * i + 3]);
+    return result / 2;
+}
+
+// Формула Симпсона для пары интервалов неравномерной сетки.
+static inline double simpson_pair(double x0, double y0, double x1, double y1, double x2, double y2)
+{
+    double h0 = x1 - x0, h1 = x2 - x1, h = h0 + h1;
+    return h / 6 * ((2 - h1 / h0) * y0 + h * h / (h0 * h1) * y1 + (2 - h0 / h1) * y2);
+}
+
+static double simpson(const double *s, uint64_t count)
+{
+    if (count < 2)
+        return 0;
+
+    uint64_t i = 0;
+    v4df acc = {};
+    if (count >= 10) {
+        v4df l0;
+        LOAD4(l0, s);
+        // Четыре пары интервалов за итерацию: точки i..i+9.
+        for (; i + 10 <= count; i += 8) {
+            v4df l1, l2, l3, l4;
+            LOAD4(l1, s + 2 * (i + 2));
+            LOAD4(l2, s + 2 * (i + 4));
+            LOAD4(l3, s + 2 * (i + 6));
+            LOAD4(l4, s + 2 * (i + 8));
+            v4df a = __builtin_shuffle(l0, l1, (v4di){ 0, 4, 1, 5 });
+            v4df b = __builtin_shuffle(l2, l3, (v4di){ 0, 4, 1, 5 });
+            v4df c = __builtin_shuffle(l0, l1, (v4di){ 2, 6, 3, 7 });
+            v4df d = __builtin_shuffle(l2, l3, (v4di){ 2, 6, 3, 7 });
+            v4df x0 = __builtin_shuffle(a, b, (v4di){ 0, 1, 4, 5 });
+            v4df y0 = __builtin_shuffle(a, b, (v4di){ 2, 3, 6, 7 });
+            v4df x1 = __builtin_shuffle(c, d, (v4di){ 0, 1, 4, 5 });
+            v4df y1 = __builtin_shuffle(c, d, (v4di){ 2, 3, 6, 7 });
+            v4df x2 = __builtin_shuffle(x0, l4, (v4di){ 1, 2, 3, 4 });
+            v4df y2 = __builtin_shuffle(y0, l4, (v4di){ 1, 2, 3, 5 });
+            v4df h0 = x1 - x0, h1 = x2 - x1, h = h0 + h1;
+            acc += h / 6 * ((2 - h1 / h0) * y0 + h * h / (h0 * h1) * y1 + (2 - h0 / h1) * y2);
+            l0 = l4;
+        }
+    }
+
+    double result = HSUM(acc);
+    for (; i + 2 < count; i += 2)
+        result += simpson_pair(s[2 * i], s[2 * i + 1], s[2 * i + 2], s[2 * i + 3], s[2 * i + 4], s[2 * i + 5]);
+    // Оставшийся нечётный интервал.
+    if (i + 1 < count)
+        result += (s[2 * i + 2] - s[2 * i]) * (s[2 * i + 1] + s[2 * i + 3]) / 2;
+    return result;
+}
+
+//============================
+// Интерфейс Управляющего узла
+//============================
+
+int sampled_make_tasks(const char *path, SAMPLED_RULE rule, uint32_t flags, size_t num_tasks,
+        struct sampled_task *tasks)
+{
+    if (!path || !tasks || !num_tasks || rule > SAMPLED_SIMPSON)
+        return -1;
+    if (strlen(path) >= SAMPLED_PATH_MAX) {
+        fprintf(stderr, "[sampled_make_tasks] Path is too long\n");
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(path, &st) == -1) {
+        fprintf(stderr, "[sampled_make_tasks] Unable to stat() %s\n", path);
+        return -1;
+    }
+    uint64_t num_samples = st.st_size / SAMPLE_SIZE;
+    uint64_t intervals = num_samples ? num_samples - 1 : 0;
+
+    uint64_t first = 0;
+    for (size_t i = 0; i < num_tasks; ++i) {
+        uint64_t part = split_intervals(intervals, num_tasks, i, rule == SAMPLED_SIMPSON);
+        memset(&tasks[i], 0, sizeof(tasks[i]));
+        tasks[i].size_of_structure = sizeof(tasks[i]);
+        tasks[i].rule = rule;
+        tasks[i].flags = flags;
+        tasks[i].offset = first * SAMPLE_SIZE;
+        tasks[i].length = part ? (part + 1) * SAMPLE_SIZE : 0;
+        strcpy(tasks[i].path, path);
+        first += part;
+    }
+    return 0;
+}
+
+//============================
+// Интерфейс исполнителя
+//============================
+
+int sampled_data_for_threads(INFO_WORKER *worker)
+{
+    struct sampled_task *task = (struct sampled_task *)worker->data;
+    if (!task || worker->n_cores <= 0 || task->rule > SAMPLED_SIMPSON ||
+            task->length % SAMPLE_SIZE || task->offset % SAMPLE_SIZE)
+        return -1;
+    task->path[SAMPLED_PATH_MAX - 1] = '\0';
+
+    size_t n_threads = worker->n_cores;
+    struct sampled_thread *threads = calloc(n_threads, sizeof(*threads));
+    if (!threads) return -1;
+
+    const double *samples = NULL;
+    void *map_base = NULL;
+    size_t map_length = 0;
+    uint64_t count = task->length / SAMPLE_SIZE;
+
+    if (count) {
+        int fd = open(task->path, O_RDONLY);
+        if (fd == -1) {
+            fprintf(stderr, "[sampled_data_for_threads] Unable to open() %s\n", task->path);
+            free(threads);
+            return -1;
+        }
+        // Копия файла на узле может быть короче, чем у Управляющего узла: чтение за концом
+        // отображения завершило бы процесс по SIGBUS.
+        struct stat st;
+        if (fstat(fd, &st) == -1 || task->length > (uint64_t)st.st_size ||
+                task->offset > (uint64_t)st.st_size - task->length) {
+            fprintf(stderr, "[sampled_data_for_threads] Range is out of %s\n", task->path);
+            close(fd);
+            free(threads);
+            return -1;
+        }
+
+        // Отображение начинается с границы страницы.
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        uint64_t map_offset = task->offset / page * page;
+        map_length = task->offset - map_offset + task->length;
+        int map_flags = MAP_SHARED | (task->flags & SAMPLED_POPULATE ? MAP_POPULATE : 0);
+        map_base = mmap(NULL, map_length, PROT_READ, map_flags, fd, map_offset);
+        close(fd);
+        if (map_base == MAP_FAILED) {
+            fprintf(stderr, "[sampled_data_for_threads] Unable to mmap() %s\n", task->path);
+            free(threads);
+            return -1;
+        }
+        madvise(map_base, map_length, MADV_SEQUENTIAL);
+        samples = (const double *)((char *)map_base + (task->offset - map_offset));
+    }
+
+    uint64_t intervals = count ? count - 1 : 0;
+    uint64_t first = 0;
+    for (size_t t = 0; t < n_threads; ++t) {
+        uint64_t part = split_intervals(intervals, n_threads, t, task->rule == SAMPLED_SIMPSON);
+        threads[t].size_of_structure = sizeof(threads[t]);
+        threads[t].rule = task->rule;
+        threads[t].samples = samples ? samples + 2 * first : NULL;
+        threads[t].count = part ? part + 1 : 0;
+        first += part;
+    }
+    threads[0].map_base = map_base;
+    threads[0].map_length = map_length;
+
+    worker->data = (char *)threads;
+    worker->size_of_structure = sizeof(*threads);
+    free(task);
+    return 0;
+}
+
+void *sampled_thread_func(void *t_args)
+{
+    struct sampled_thread *args = (struct sampled_thread *)t_args;
+    double partial = 0;
+
+    // Блоки по чётному числу интервалов с общей граничной точкой: между блоками
+    // проверяется токен отмены, а формула Симпсона не меняет разбиение на пары.
+    for (uint64_t first = 0; first + 1 < args->count; first += WORKER_CANCEL_BLOCK) {
+        if (first && worker_cancelled())
+            break;
+        uint64_t count = args->count - first > WORKER_CANCEL_BLOCK ? WORKER_CANCEL_BLOCK + 1 : args->count - first;
+        if (args->rule == SAMPLED_SIMPSON)
+            partial += simpson(args->samples + 2 * first, count);
+        else
+            partial += trapezoid(args->samples + 2 * first, count);
+    }
+    args->partial = partial;
+    return NULL;
+}
+
+void sampled_collect(INFO_WORKER *worker)
+{
+    struct sampled_thread *threads = (struct sampled_thread *)worker->data;
+    double result = 0;
+
+    for (int t = 0; t < worker->n_cores; ++t)
+        result += threads[t].partial;
+    memcpy(worker->result, &result, sizeof(result));
+    sampled_release(worker);
+}
+
+void sampled_release(INFO_WORKER *worker)
+{
+    struct sampled_thread *threads = (struct sampled_thread *)worker->data;
+    if (threads && threads[0].map_base) {
+        munmap(threads[0].map_base, threads[0].map_length);
+        threads[0].map_base = NULL;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef SAMPLED_H
+#define SAMPLED_H
+
+//================
+// Интегрирование дискретных сигналов из больших файлов выборок.
+//================
+#include <stddef.h>
+#include <stdint.h>
+
+#include "worker.h"
+
+//! Максимальная длина пути к файлу выборок.
+#define SAMPLED_PATH_MAX 256
+
+//! Квадратурная формула для выборок.
+typedef enum
+{
+    // Формула трапеций.
+    SAMPLED_TRAPEZOID,
+    // Формула Симпсона для неравномерной сетки (последний нечётный интервал - трапециями).
+    SAMPLED_SIMPSON,
+} SAMPLED_RULE;
+
+//! Флаги задачи.
+typedef enum
+{
+    // Заранее загрузить весь отображаемый диапазон (MAP_POPULATE).
+    SAMPLED_POPULATE = 1U << 0,
+} SAMPLED_FLAGS;
+
+//! Задача для рабочего узла: диапазон байт общего файла.
+//! Файл состоит из пар (x, y) типа double с возрастающими x и должен быть доступен
+//! рабочим узлам по тому же пути (например, через общую файловую систему).
+struct sampled_task {
+    // Размер структуры (по соглашению библиотеки - первое поле задачи).
+    size_t size_of_structure;
+    // Квадратурная формула (SAMPLED_RULE).
+    uint32_t rule;
+    // Флаги (SAMPLED_FLAGS).
+    uint32_t flags;
+    // Смещение и длина диапазона в байтах; соседние диапазоны имеют одну общую точку.
+    uint64_t offset;
+    uint64_t length;
+    // Путь к файлу выборок.
+    char path[SAMPLED_PATH_MAX];
+};
+
+/*!
+ * \brief Функция для разбиения файла выборок на задачи для Управляющего узла.
+ *
+ * \param[in] path Путь к файлу выборок.
+ * \param[in] rule Квадратурная формула.
+ * \param[in] flags Флаги задачи.
+ * \param[in] num_tasks Количество задач.
+ * \param[out] tasks Массив из num_tasks задач.
+ *
+ * \return 0 в случае успеха, -1 при ошибке.
+ *
+ * \details По сети передаются только диапазоны байт; сами выборки читаются рабочими узлами
+ *          из файла. Для формулы Симпсона каждый диапазон, кроме последнего, содержит
+ *          чётное число интервалов. Результат каждой задачи - одно число double.
+ */
+int sampled_make_tasks(const char *path, SAMPLED_RULE rule, uint32_t flags, size_t num_tasks,
+        struct sampled_task *tasks);
+
+// Отображение диапазона файла в память и разбиение его по ядрам исполнителя.
+int sampled_data_for_threads(INFO_WORKER *worker);
+
+// Процедура потока: сумма по своей части выборок.
+void *sampled_thread_func(void *t_args);
+
+// Сложение результатов потоков в worker->result и освобождение отображения.
+void sampled_collect(INFO_WORKER *worker);
+
+// Освобождение отображения без результата (вычисление отменено).
+void sampled_release(INFO_WORKER *worker);
+
+#endif // SAMPLED_H
@@ -0,0 +1,297 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "trace.h"
+
+// Количество событий в одном блоке буфера потока.
+#define TRACE_CHUNK_EVENTS 1024
+
+struct trace_chunk {
+    struct trace_event events[TRACE_CHUNK_EVENTS];
+    _Atomic(struct trace_chunk *) next;
+};
+
+//! Состояния буфера потока
+typedef enum
+{
+    BUFFER_OWNED,  // -> BUFFER_CLOSED
+    BUFFER_CLOSED, // -> BUFFER_FREE
+    BUFFER_FREE,   // -> BUFFER_OWNED
+} BUFFER_STATE;
+
+// Буфер потока: пишет только поток-владелец, читает только сборщик.
+// Буферы завершившихся потоков после вычитывания достаются новым потокам.
+struct trace_buffer {
+    _Atomic int state;
+    uint32_t tid;
+    // Сторона записи.
+    struct trace_chunk *write_chunk;
+    size_t write_pos;
+    _Atomic uint64_t written;
+    // Сторона чтения.
+    struct trace_chunk *read_chunk;
+    size_t read_pos;
+    uint64_t read;
+    // Список всех буферов; поле не меняется после добавления в список.
+    struct trace_buffer *next;
+};
+
+bool trace_enabled = false;
+
+static _Atomic(struct trace_buffer *) trace_buffers = NULL;
+static _Atomic uint32_t trace_next_tid = 0;
+static _Thread_local struct trace_buffer *local_buffer = NULL;
+static pthread_key_t buffer_key;
+static pthread_once_t buffer_key_once = PTHREAD_ONCE_INIT;
+static uint64_t trace_base_ns = 0;
+
+uint64_t trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void buffer_release(void *buffer)
+{
+    atomic_store_explicit(&((struct trace_buffer *)buffer)->state, BUFFER_CLOSED, memory_order_release);
+}
+
+static void buffer_key_create(void)
+{
+    pthread_key_create(&buffer_key, buffer_release);
+}
+
+void trace_enable(void)
+{
+    pthread_once(&buffer_key_once, buffer_key_create);
+    if (!trace_base_ns)
+        trace_base_ns = trace_now_ns();
+    trace_enabled = true;
+}
+
+static struct trace_buffer *buffer_acquire(void)
+{
+    struct trace_buffer *buffer;
+
+    for (buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        int expected = BUFFER_FREE;
+        if (atomic_compare_exchange_strong(&buffer->state, &expected, BUFFER_OWNED))
+            break;
+    }
+
+    if (!buffer) {
+        buffer = calloc(1, sizeof(*buffer));
+        struct trace_chunk *chunk = calloc(1, sizeof(*chunk));
+        if (!buffer || !chunk) {
+            free(buffer);
+            free(chunk);
+            return NULL;
+        }
+        buffer->state = BUFFER_OWNED;
+        buffer->write_chunk = chunk;
+        buffer->read_chunk = chunk;
+        buffer->next = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&trace_buffers, &buffer->next, buffer,
+                    memory_order_release, memory_order_relaxed))
+            ;
+    }
+
+    buffer->tid = atomic_fetch_add_explicit(&trace_next_tid, 1, memory_order_relaxed);
+    pthread_setspecific(buffer_key, buffer);
+    return buffer;
+}
+
+static struct trace_buffer *buffer_local(void)
+{
+    if (!local_buffer)
+        local_buffer = buffer_acquire();
+    return local_buffer;
+}
+
+static void trace_push(struct trace_buffer *buffer, const struct trace_event *event)
+{
+    if (buffer->write_pos == TRACE_CHUNK_EVENTS) {
+        struct trace_chunk *chunk = calloc(1, sizeof(*chunk));
+        if (!chunk)
+            return;
+        atomic_store_explicit(&buffer->write_chunk->next, chunk, memory_order_release);
+        buffer->write_chunk = chunk;
+        buffer->write_pos = 0;
+    }
+    buffer->write_chunk->events[buffer->write_pos++] = *event;
+    atomic_fetch_add_explicit(&buffer->written, 1, memory_order_release);
+}
+
+void trace_span(const char *name, uint64_t start_ns)
+{
+    if (!start_ns)
+        return;
+    struct trace_buffer *buffer = buffer_local();
+    if (!buffer)
+        return;
+
+    struct trace_event event = {};
+    strncpy(event.name, name, TRACE_NAME_MAX - 1);
+    event.ts_ns = start_ns;
+    event.dur_ns = trace_now_ns() - start_ns;
+    event.pid = 0;
+    event.tid = buffer->tid;
+    trace_push(buffer, &event);
+}
+
+// Вычитывание событий буфера; callback получает каждое событие по порядку.
+static void buffer_drain(struct trace_buffer *buffer, void (*callback)(const struct trace_event *, void *), void *ctx)
+{
+    int state = atomic_load_explicit(&buffer->state, memory_order_acquire);
+    uint64_t written = atomic_load_explicit(&buffer->written, memory_order_acquire);
+
+    while (buffer->read < written) {
+        if (buffer->read_pos == TRACE_CHUNK_EVENTS) {
+            struct trace_chunk *next = atomic_load_explicit(&buffer->read_chunk->next, memory_order_acquire);
+            free(buffer->read_chunk);
+            buffer->read_chunk = next;
+            buffer->read_pos = 0;
+        }
+        callback(&buffer->read_chunk->events[buffer->read_pos++], ctx);
+        buffer->read++;
+    }
+
+    if (state == BUFFER_CLOSED)
+        atomic_store_explicit(&buffer->state, BUFFER_FREE, memory_order_release);
+}
+
+static size_t trace_pending(void)
+{
+    size_t count = 0;
+    for (struct trace_buffer *buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire);
+            buffer; buffer = buffer->next)
+        count += atomic_load_explicit(&buffer->written, memory_order_acquire) - buffer->read;
+    return count;
+}
+
+struct collect_ctx {
+    struct trace_block *block;
+    size_t capacity;
+};
+
+static void collect_event(const struct trace_event *event, void *ctx)
+{
+    struct collect_ctx *collect = ctx;
+    if (collect->block->count == TRACE_MAX_EVENTS)
+        return;
+    if (collect->block->count == collect->capacity) {
+        // События, записанные после подсчёта, тоже попадают в блок.
+        size_t capacity = collect->capacity ? 2 * collect->capacity : 64;
+        if (capacity > TRACE_MAX_EVENTS)
+            capacity = TRACE_MAX_EVENTS;
+        struct trace_block *block = realloc(collect->block,
+                sizeof(struct trace_block) + capacity * sizeof(struct trace_event));
+        if (!block)
+            return;
+        collect->block = block;
+        collect->capacity = capacity;
+    }
+    collect->block->events[collect->block->count++] = *event;
+}
+
+struct trace_block *trace_collect(uint64_t task_recv_ns, size_t *size)
+{
+    size_t capacity = trace_pending();
+    if (capacity > TRACE_MAX_EVENTS)
+        capacity = TRACE_MAX_EVENTS;
+    struct collect_ctx ctx = {
+        .block = malloc(sizeof(struct trace_block) + capacity * sizeof(struct trace_event)),
+        .capacity = capacity,
+    };
+    if (!ctx.block)
+        return NULL;
+
+    ctx.block->count = 0;
+    for (struct trace_buffer *buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire);
+            buffer; buffer = buffer->next)
+        buffer_drain(buffer, collect_event, &ctx);
+
+    ctx.block->task_recv_ns = task_recv_ns;
+    ctx.block->send_ns = trace_now_ns();
+    *size = sizeof(struct trace_block) + ctx.block->count * sizeof(struct trace_event);
+    return ctx.block;
+}
+
+int64_t trace_clock_offset(const struct trace_block *block, uint64_t task_sent_ns, uint64_t recv_ns,
+        uint64_t *delay_ns)
+{
+    // Смещение часов рабочего узла относительно Управляющего (как в NTP):
+    // ((T2 - T1) + (T3 - T4)) / 2, где T1, T4 - часы Управляющего узла, T2, T3 - рабочего.
+    *delay_ns = (recv_ns - task_sent_ns) - (block->send_ns - block->task_recv_ns);
+    return ((int64_t)(block->task_recv_ns - task_sent_ns) + (int64_t)(block->send_ns - recv_ns)) / 2;
+}
+
+void trace_import(const struct trace_block *block, uint32_t pid, int64_t offset_ns)
+{
+    struct trace_buffer *buffer = buffer_local();
+    if (!buffer)
+        return;
+
+    for (uint64_t i = 0; i < block->count; ++i) {
+        struct trace_event event = block->events[i];
+        event.name[TRACE_NAME_MAX - 1] = '\0';
+        event.ts_ns -= offset_ns;
+        event.pid = pid;
+        trace_push(buffer, &event);
+    }
+}
+
+struct json_ctx {
+    FILE *file;
+    bool first;
+    uint32_t max_pid;
+};
+
+static void json_event(const struct trace_event *event, void *ctx)
+{
+    struct json_ctx *json = ctx;
+    double ts_us = ((int64_t)(event->ts_ns - trace_base_ns)) / 1000.0;
+
+    fprintf(json->file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u}",
+            json->first ? "" : ",", event->name, ts_us, event->dur_ns / 1000.0, event->pid, event->tid);
+    json->first = false;
+    if (event->pid > json->max_pid)
+        json->max_pid = event->pid;
+}
+
+int trace_write_json(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "[trace_write_json] Unable to open %s\n", path);
+        return -1;
+    }
+
+    struct json_ctx ctx = { .file = file, .first = true, .max_pid = 0 };
+    fprintf(file, "{\"traceEvents\":[");
+    for (struct trace_buffer *buffer = atomic_load_explicit(&trace_buffers, memory_order_acquire);
+            buffer; buffer = buffer->next)
+        buffer_drain(buffer, json_event, &ctx);
+
+    for (uint32_t pid = 0; pid <= ctx.max_pid; ++pid) {
+        fprintf(file, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                ctx.first ? "" : ",", pid, pid ? "worker" : "manager", pid);
+        ctx.first = false;
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file)) {
+        fprintf(stderr, "[trace_write_json] Unable to write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
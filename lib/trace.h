@@ -0,0 +1,96 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+//================
+// Трассировка в формате Chrome trace-event (Perfetto, chrome://tracing).
+//================
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Максимальная длина имени события вместе с завершающим нулём.
+#define TRACE_NAME_MAX 32
+
+//! Событие трассировки; в этом же виде события передаются по сети.
+struct trace_event {
+    char name[TRACE_NAME_MAX];
+    // Начало и длительность в наносекундах (CLOCK_MONOTONIC узла, где событие записано).
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+    // Номер процесса: 0 - Управляющий узел, 1 и далее - рабочие узлы.
+    uint32_t pid;
+    uint32_t tid;
+};
+
+//! Наибольшее количество событий в одном блоке рабочего узла (около 3.5 МБ); события сверх него
+//! отбрасываются при сборе, а блок большего размера Управляющий узел не принимает.
+#define TRACE_MAX_EVENTS 65536
+
+//! Заголовок блока событий рабочего узла (сообщение MSG_TRACE).
+struct trace_block {
+    // Время получения задачи и время отправки блока по часам рабочего узла:
+    // вместе с временем отправки задачи и получения блока на Управляющем узле
+    // они дают смещение часов рабочего узла.
+    uint64_t task_recv_ns;
+    uint64_t send_ns;
+    uint64_t count;
+    struct trace_event events[];
+};
+
+// Флаг включения трассировки; проверяется макросами перед любой записью.
+extern bool trace_enabled;
+
+// Текущее время CLOCK_MONOTONIC в наносекундах.
+uint64_t trace_now_ns(void);
+
+// Включение трассировки (до запуска рабочих потоков).
+void trace_enable(void);
+
+// Запись завершённого события [start_ns, now] в буфер текущего потока.
+void trace_span(const char *name, uint64_t start_ns);
+
+/*!
+ * \brief Функция для сбора событий, записанных с момента предыдущего вызова.
+ *
+ * \param[out] size Размер блока в байтах.
+ * \param[in] task_recv_ns Время получения текущей задачи.
+ *
+ * \return Блок событий (освобождается вызывающим) или NULL при ошибке.
+ *
+ * \details В блок попадает не больше TRACE_MAX_EVENTS событий, остальные отбрасываются.
+ */
+struct trace_block *trace_collect(uint64_t task_recv_ns, size_t *size);
+
+/*!
+ * \brief Функция для оценки смещения часов рабочего узла по одному обмену задача-ответ.
+ *
+ * \param[in] block Блок событий рабочего узла.
+ * \param[in] task_sent_ns Время отправки задачи рабочему узлу.
+ * \param[in] recv_ns Время получения блока.
+ * \param[out] delay_ns Задержка обмена без времени вычисления: чем она меньше, тем точнее оценка.
+ *
+ * \return Смещение часов рабочего узла относительно часов Управляющего узла.
+ */
+int64_t trace_clock_offset(const struct trace_block *block, uint64_t task_sent_ns, uint64_t recv_ns,
+        uint64_t *delay_ns);
+
+// Добавление событий рабочего узла к трассе Управляющего узла под номером процесса pid.
+void trace_import(const struct trace_block *block, uint32_t pid, int64_t offset_ns);
+
+// Запись всех событий в файл trace-event JSON.
+int trace_write_json(const char *path);
+
+// Сборка с -DNO_TRACE полностью убирает трассировку из кода.
+#ifdef NO_TRACE
+#define TRACE_START() ((uint64_t)0)
+#define TRACE_SPAN(name, start_ns) ((void)(start_ns))
+#else
+#define TRACE_START() (__builtin_expect(trace_enabled, 0) ? trace_now_ns() : (uint64_t)0)
+#define TRACE_SPAN(name, start_ns)                      \
+    do {                                                \
+        if (__builtin_expect(trace_enabled, 0))         \
+            trace_span((name), (start_ns));             \
+    } while (0)
+#endif
+
+#endif // TRACE_H
@@ -9,11 +9,14 @@
 #include <stdbool.h>
 #include <math.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/sysinfo.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include <fcntl.h>
 #include <netdb.h>
@@ -24,7 +27,10 @@
 #include <assert.h>
 
 #include "common.h"
+#include "trace.h"
+#include "log.h"
 #include "worker.h"
+#include "profile.h"
 
 //==================
 // Управление сетью
@@ -69,30 +75,227 @@ static bool worker_connect_to_server(INFO_WORKER* worker)
 // Передача данных по сети.
 //=================================
 
-static bool get_data(INFO_WORKER* worker)
+// Пауза в цикле активного ожидания.
+#if defined(__x86_64__) || defined(__i386__)
+#define SPIN_PAUSE() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define SPIN_PAUSE() __asm__ __volatile__("yield")
+#else
+#define SPIN_PAUSE() ((void)0)
+#endif
+
+// Приём ровно size байт. В режиме низкой задержки сокет опрашивается без блокировки, пока
+// с последних полученных данных не прошло busy_poll_us, и только затем поток засыпает в recv.
+static bool worker_recv(INFO_WORKER *worker, void *buf, size_t size)
 {
-    size_t bytes_read = recv(worker->server_conn_fd, worker->data, worker->size_of_structure, MSG_WAITALL);
-    if (bytes_read != worker->size_of_structure)
+    size_t got = 0;
+    if (worker->busy_poll_us) {
+        uint64_t spin_ns = (uint64_t)worker->busy_poll_us * 1000;
+        uint64_t deadline_ns = trace_now_ns() + spin_ns;
+        while (got < size) {
+            ssize_t ret = recv(worker->server_conn_fd, (char *)buf + got, size - got, MSG_DONTWAIT);
+            if (ret > 0) {
+                got += ret;
+                deadline_ns = trace_now_ns() + spin_ns;
+                continue;
+            }
+            if (ret == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                return false;
+            if (trace_now_ns() >= deadline_ns)
+                break;
+            SPIN_PAUSE();
+        }
+        if (got == size)
+            return true;
+    }
+    ssize_t ret = recv(worker->server_conn_fd, (char *)buf + got, size - got, MSG_WAITALL);
+    return ret >= 0 && (size_t)ret == size - got;
+}
+
+// Задача, принятая заранее.
+struct prefetched_task {
+    char *data;
+    size_t size;
+    // Время получения задачи (для выравнивания часов при трассировке).
+    uint64_t recv_ns;
+};
+
+//! Очередь заранее принятых задач
+struct worker_prefetch {
+    // Поток приёма задач.
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    // Кольцо принятых задач на credits элементов.
+    struct prefetched_task *tasks;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+    // Задач больше не будет: 1 - получен признак конца, -1 - ошибка приёма.
+    int finished;
+};
+
+// Первое поле задачи - её полный размер, поэтому задачи могут иметь переменную длину.
+// Нулевой размер означает, что задач больше нет.
+// Возвращает 1 при получении задачи, 0 при окончании задач и -1 при ошибке.
+static int get_data(INFO_WORKER* worker, struct prefetched_task *task)
+{
+    uint64_t trace_start = TRACE_START();
+    size_t size = 0;
+    if (!worker_recv(worker, &size, sizeof(size)))
+    {
+        fprintf(stderr, "[get_data] unable to recv data size from server\n");
+        return -1;
+    }
+    if (size == TASK_SIZE_END)
+    {
+        return 0;
+    }
+    if (size == TASK_SIZE_CANCEL)
+    {
+        // Задание отменено: выполняемая задача прерывается, принятые заранее не нужны.
+        worker_cancel();
+        return 0;
+    }
+    if (size < sizeof(size) || size > worker->max_task_size)
+    {
+        fprintf(stderr, "[get_data] wrong data size %lu\n", size);
+        return -1;
+    }
+
+    char *data = malloc(size);
+    if (!data)
+    {
+        fprintf(stderr, "[get_data] Unable to allocate memory\n");
+        return -1;
+    }
+    memcpy(data, &size, sizeof(size));
+
+    if (!worker_recv(worker, data + sizeof(size), size - sizeof(size)))
     {
         fprintf(stderr, "[get_data] unable to recv data from server\n");
+        free(data);
+        return -1;
+    }
+    task->data = data;
+    task->size = size;
+    TRACE_SPAN("recv_task", trace_start);
+    task->recv_ns = worker->trace ? trace_now_ns() : 0;
+
+    return 1;
+}
+
+// Поток приёма: задачи принимаются, пока выполняются предыдущие, поэтому задержка сети
+// скрывается за вычислением. Управляющий узел не выдаёт больше задач, чем заявлено кредитов.
+static void *prefetch_thread_func(void *t_args)
+{
+    INFO_WORKER *worker = (INFO_WORKER *)t_args;
+    struct worker_prefetch *prefetch = worker->prefetch;
+    int ret = 1;
+
+    while (ret == 1) {
+        struct prefetched_task task;
+        ret = get_data(worker, &task);
+
+        pthread_mutex_lock(&prefetch->lock);
+        if (ret == 1 && prefetch->count == prefetch->capacity) {
+            fprintf(stderr, "[prefetch_thread_func] Server exceeded credits\n");
+            free(task.data);
+            ret = -1;
+        }
+        if (ret == 1) {
+            prefetch->tasks[(prefetch->head + prefetch->count) % prefetch->capacity] = task;
+            prefetch->count++;
+        } else {
+            prefetch->finished = ret == 0 ? 1 : -1;
+            // Соединение потеряно: задание брошено, ядра освобождаются.
+            if (ret < 0)
+                worker_cancel();
+        }
+        pthread_cond_signal(&prefetch->ready);
+        pthread_mutex_unlock(&prefetch->lock);
+    }
+    return NULL;
+}
+
+static bool prefetch_start(INFO_WORKER *worker)
+{
+    struct worker_prefetch *prefetch = calloc(1, sizeof(*prefetch));
+    uint32_t capacity = worker->credits ? worker->credits : 1;
+    if (!prefetch || !(prefetch->tasks = calloc(capacity, sizeof(*prefetch->tasks)))) {
+        fprintf(stderr, "[prefetch_start] Unable to allocate memory\n");
+        free(prefetch);
         return false;
     }
+    prefetch->capacity = capacity;
+    pthread_mutex_init(&prefetch->lock, NULL);
+    pthread_cond_init(&prefetch->ready, NULL);
+
+    // В режиме низкой задержки поток приёма занимает первое ядро после ядер вычисления.
+    pthread_attr_t thread_attr;
+    pthread_attr_init(&thread_attr);
+    if (worker->busy_poll_us) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(worker->n_cores % get_nprocs(), &cpuset);
+        if (pthread_attr_setaffinity_np(&thread_attr, sizeof(cpuset), &cpuset))
+            LOG_WARN("[prefetch_start] Unable to pin receiving thread");
+    }
 
+    worker->prefetch = prefetch;
+    int ret = pthread_create(&prefetch->thread, &thread_attr, prefetch_thread_func, worker);
+    pthread_attr_destroy(&thread_attr);
+    if (ret) {
+        fprintf(stderr, "[prefetch_start] Unable to create thread\n");
+        worker->prefetch = NULL;
+        free(prefetch->tasks);
+        free(prefetch);
+        return false;
+    }
     return true;
 }
 
+static void prefetch_stop(INFO_WORKER *worker)
+{
+    struct worker_prefetch *prefetch = worker->prefetch;
+    if (!prefetch)
+        return;
+
+    // Поток приёма может ждать данных: прерываем его.
+    pthread_mutex_lock(&prefetch->lock);
+    bool finished = prefetch->finished;
+    pthread_mutex_unlock(&prefetch->lock);
+    if (!finished)
+        shutdown(worker->server_conn_fd, SHUT_RDWR);
+    pthread_join(prefetch->thread, NULL);
+
+    for (uint32_t i = 0; i < prefetch->count; ++i)
+        free(prefetch->tasks[(prefetch->head + i) % prefetch->capacity].data);
+    pthread_mutex_destroy(&prefetch->lock);
+    pthread_cond_destroy(&prefetch->ready);
+    free(prefetch->tasks);
+    free(prefetch);
+    worker->prefetch = NULL;
+}
+
 static bool send_node_info(INFO_WORKER *worker)
 {
     if (!worker)
         return false;
 
-    size_t bytes_written = write(worker->server_conn_fd, &worker->n_cores,
-            sizeof(worker->n_cores));
-    if (bytes_written != sizeof(worker->n_cores))
+    uint64_t trace_start = TRACE_START();
+    struct node_info info = {
+        .n_cores = worker->n_cores,
+        .credits = worker->credits ? worker->credits : 1,
+    };
+    memcpy(info.evals_per_sec, worker->evals_per_sec, sizeof(info.evals_per_sec));
+    size_t bytes_written = write(worker->server_conn_fd, &info, sizeof(info));
+    if (bytes_written != sizeof(info))
     {
         fprintf(stderr, "Unable to send node info to server\n");
         return false;
     }
+    TRACE_SPAN("handshake", trace_start);
 
     return true;
 }
@@ -101,28 +304,180 @@ static bool send_node_info(INFO_WORKER *worker)
 // Интерфейс исполнителя
 //============================
 
+extern pthread_mutex_t mutex;
+
+// Последняя оценка, сообщённая потоком вычисления (защищена mutex).
+struct partial_slot {
+    double value;
+    double error;
+    double coverage;
+};
+
+static _Thread_local struct partial_slot *local_partial = NULL;
+
+// Аргументы обёртки, записывающей время вычисления потока и его промежуточные результаты.
+struct traced_thread {
+    void *(*thread_func)(void *);
+    void *arg;
+    struct partial_slot *partial;
+};
+
+static void *traced_thread_func(void *t_args)
+{
+    struct traced_thread *traced = (struct traced_thread *)t_args;
+    uint64_t trace_start = TRACE_START();
+    local_partial = traced->partial;
+    traced->thread_func(traced->arg);
+    TRACE_SPAN("compute", trace_start);
+    return NULL;
+}
+
+void worker_partial(double value, double error, double coverage)
+{
+    struct partial_slot *slot = local_partial;
+    if (!slot)
+        return;
+    pthread_mutex_lock(&mutex);
+    slot->value = value;
+    slot->error = error;
+    slot->coverage = coverage;
+    pthread_mutex_unlock(&mutex);
+}
+
+static bool send_message(INFO_WORKER *worker, uint32_t type, const void *data, size_t size, uint32_t compute_us);
+
+// Отправка суммы оценок потоков; каждый поток считает равную долю задачи.
+static void send_partial(INFO_WORKER *worker, const struct partial_slot *slots, int threads_num)
+{
+    struct partial_result partial = {};
+    pthread_mutex_lock(&mutex);
+    for (int i = 0; i < threads_num; ++i) {
+        partial.value += slots[i].value;
+        partial.error += slots[i].error;
+        partial.coverage += slots[i].coverage / threads_num;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (!send_message(worker, MSG_PARTIAL, &partial, sizeof(partial), 0))
+        LOG_WARN("[distributed_counting] unable to send partial result");
+}
+
+static void timespec_add_ms(struct timespec *ts, uint32_t ms)
+{
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+//============================
+// Отмена вычисления
+//============================
+
+//! Токен отмены
+struct cancel_token {
+    atomic_bool requested;
+    // Истёк крайний срок: прерывается только текущее вычисление, соединение сохраняется.
+    atomic_bool expired;
+    // Крайний срок по CLOCK_MONOTONIC_COARSE (0 - не задан).
+    _Atomic uint64_t deadline_ns;
+};
+
+// Токен рабочего узла: текущая задача, полученная от Управляющего узла.
+static struct cancel_token worker_token;
+// Токен пула start_local для его потоков (NULL - токен рабочего узла), чтобы локальный
+// запуск не сбрасывал отмену и крайний срок рабочего узла в том же процессе.
+static _Thread_local struct cancel_token *local_token = NULL;
+
+static struct cancel_token *current_token(void)
+{
+    return local_token ? local_token : &worker_token;
+}
+
+static uint64_t coarse_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void token_set_deadline(struct cancel_token *token, time_t max_time)
+{
+    if (max_time > 0)
+        atomic_store_explicit(&token->deadline_ns, coarse_now_ns() + (uint64_t)max_time * 1000000000ULL,
+                memory_order_relaxed);
+}
+
+void worker_cancel(void)
+{
+    atomic_store_explicit(&current_token()->requested, true, memory_order_relaxed);
+}
+
+bool worker_cancelled(void)
+{
+    struct cancel_token *token = current_token();
+    if (atomic_load_explicit(&token->requested, memory_order_relaxed) ||
+            atomic_load_explicit(&token->expired, memory_order_relaxed))
+        return true;
+    uint64_t deadline = atomic_load_explicit(&token->deadline_ns, memory_order_relaxed);
+    if (deadline && coarse_now_ns() >= deadline) {
+        atomic_store_explicit(&token->expired, true, memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+// Снятие крайнего срока после вычисления: 1, если вычисление было отменено, 2, если истёк
+// крайний срок (следующая задача считается с новым сроком).
+static int counting_finish(struct cancel_token *token)
+{
+    atomic_store_explicit(&token->deadline_ns, 0, memory_order_relaxed);
+    if (atomic_load_explicit(&token->requested, memory_order_relaxed)) {
+        LOG_WARN("[distributed_counting] computation cancelled");
+        return 1;
+    }
+    if (atomic_exchange_explicit(&token->expired, false, memory_order_relaxed)) {
+        LOG_WARN("[distributed_counting] task deadline expired");
+        return 2;
+    }
+    return 0;
+}
+
 int distributed_counting(INFO_WORKER *worker, void*(thread_func(void*)))
 {
     time_t start_time = time(NULL);
+    uint64_t trace_start = TRACE_START();
     // Проверка валидности запрашиваемого числа ядер
     if (worker->n_cores > get_nprocs()) {
         fprintf(stderr, 
                 "[distributed_counting] the number of processors currently available in the system is less than required\n");
         return -1;
     }
+    // Крайний срок задачи: по его истечении ядра прерываются так же, как при отмене,
+    // но соединение сохраняется (см. send_expired).
+    token_set_deadline(&worker_token, worker->max_time);
 
     int threads_num = worker->n_cores;
     
     if (!threads_num) {
         fprintf(stderr, "Number of required cores should be greater than zero\n");
         exit(EXIT_FAILURE);
-    } else if (threads_num == 1) {
+    } else if (threads_num == 1 && !worker->partial_ms) {
+        uint64_t trace_compute = TRACE_START();
         thread_func(worker->data);
-        fprintf(stderr, "TIME: %d\nn_cores=%d\n", time(NULL) - start_time, worker->n_cores);
-        return 0;
+        TRACE_SPAN("compute", trace_compute);
+        LOG_INFO("[distributed_counting] TIME: %lds, n_cores=%d", (long)(time(NULL) - start_time), worker->n_cores);
+        TRACE_SPAN("distributed_counting", trace_start);
+        return counting_finish(&worker_token);
     }
     pthread_t threads[threads_num];
     char *args[threads_num];
+    struct traced_thread traced[threads_num];
+    // Пока поток ничего не сообщил, его оценка не известна.
+    struct partial_slot partials[threads_num];
+    bool wrap = trace_enabled || worker->partial_ms;
 
     for (int i = 0; i < threads_num; ++i) {
         // Выбор ядра для выполнения потока.
@@ -143,8 +498,13 @@ int distributed_counting(INFO_WORKER *worker, void*(thread_func(void*)))
         }
 
         args[i] = worker->data + worker->size_of_structure * i;
+        partials[i] = (struct partial_slot){ .value = 0, .error = INFINITY, .coverage = 0 };
+        traced[i].thread_func = thread_func;
+        traced[i].arg = args[i];
+        traced[i].partial = worker->partial_ms ? &partials[i] : NULL;
          
-        if (pthread_create(&threads[i], &thread_attr, thread_func, args[i])) {
+        if (pthread_create(&threads[i], &thread_attr, wrap ? traced_thread_func : thread_func,
+                    wrap ? (void *)&traced[i] : (void *)args[i])) {
             fprintf(stderr, "Unable to create thread\n");
             return -1;
         }
@@ -157,26 +517,149 @@ int distributed_counting(INFO_WORKER *worker, void*(thread_func(void*)))
 
     }
 
-    // Ждём завершения потоков
+    // Ждём завершения потоков, отправляя промежуточные результаты раз в partial_ms.
+    struct timespec next_partial;
+    clock_gettime(CLOCK_REALTIME, &next_partial);
+    timespec_add_ms(&next_partial, worker->partial_ms);
     for (int i = 0; i < threads_num; ++i)
     {
-        if (pthread_join(threads[i], NULL)) {
+        int ret;
+        if (worker->partial_ms) {
+            while ((ret = pthread_timedjoin_np(threads[i], NULL, &next_partial)) == ETIMEDOUT) {
+                if (!worker_cancelled())
+                    send_partial(worker, partials, threads_num);
+                timespec_add_ms(&next_partial, worker->partial_ms);
+            }
+        } else {
+            ret = pthread_join(threads[i], NULL);
+        }
+        if (ret) {
             fprintf(stderr, "Unable to join a thread\n");
             return -1;
         }
     }
-    fprintf(stderr, "TIME: %d\nn_cores=%d\n", time(NULL) - start_time, worker->n_cores);
+    LOG_INFO("[distributed_counting] TIME: %lds, n_cores=%d", (long)(time(NULL) - start_time), worker->n_cores);
+    TRACE_SPAN("distributed_counting", trace_start);
 
-    return 0;
+    return counting_finish(&worker_token);
 }
 
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Результат задачи, выполняемой потоком пула локального режима (NULL вне пула).
+static _Thread_local char *local_result = NULL;
+
 void worker_add_result(INFO_WORKER *worker, char *result, void(add_func(char*, char*)))
 {
+    uint64_t trace_start = TRACE_START();
+    if (local_result) {
+        // Задача целиком выполняется одним потоком пула: блокировка не нужна.
+        add_func(local_result, result);
+        TRACE_SPAN("reduce", trace_start);
+        return;
+    }
     pthread_mutex_lock(&mutex);
     add_func(worker->result, result);
     pthread_mutex_unlock(&mutex);
+    TRACE_SPAN("reduce", trace_start);
+}
+
+//============================
+// Локальное выполнение
+//============================
+
+//! Пул потоков локального режима
+struct local_pool {
+    void *(*thread_func)(void *);
+    char *tasks;
+    size_t size_of_structure;
+    char *ans;
+    size_t size_of_result;
+    size_t num_tasks;
+    // Номер следующей невыданной задачи: потоки забирают задачи атомарным инкрементом.
+    atomic_size_t next_task;
+    // Отмена и крайний срок запуска.
+    struct cancel_token token;
+};
+
+static void *local_thread_func(void *t_args)
+{
+    struct local_pool *pool = (struct local_pool *)t_args;
+    local_token = &pool->token;
+    for (;;) {
+        size_t task_i = atomic_fetch_add_explicit(&pool->next_task, 1, memory_order_relaxed);
+        if (task_i >= pool->num_tasks || worker_cancelled())
+            break;
+        uint64_t trace_start = TRACE_START();
+        local_result = pool->ans + task_i * pool->size_of_result;
+        memset(local_result, 0, pool->size_of_result);
+        pool->thread_func(pool->tasks + task_i * pool->size_of_structure);
+        TRACE_SPAN("compute", trace_start);
+    }
+    local_result = NULL;
+    local_token = NULL;
+    return NULL;
+}
+
+int start_local(size_t size_of_structure, size_t size_of_result, size_t num_tasks, char *tasks, char *ans,
+        int n_threads, time_t max_time, void*(thread_func(void*)))
+{
+    if (!size_of_structure || !size_of_result || !num_tasks || !tasks || !ans || n_threads <= 0 || !thread_func)
+        return -1;
+    if (n_threads > get_nprocs()) {
+        fprintf(stderr,
+                "[start_local] the number of processors currently available in the system is less than required\n");
+        return -1;
+    }
+    uint64_t trace_start = TRACE_START();
+    struct local_pool pool = {
+        .thread_func = thread_func,
+        .tasks = tasks,
+        .size_of_structure = size_of_structure,
+        .ans = ans,
+        .size_of_result = size_of_result,
+        .num_tasks = num_tasks,
+    };
+    // Время max_time отсчитывается для всего запуска; по его истечении ядра прерываются как при отмене.
+    token_set_deadline(&pool.token, max_time);
+
+    if ((size_t)n_threads > num_tasks)
+        n_threads = num_tasks;
+    pthread_t threads[n_threads];
+    int num_started = 0;
+    bool failed = false;
+    for (int i = 0; i < n_threads; ++i) {
+        // Потоки пула закрепляются за ядрами так же, как потоки distributed_counting.
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(i, &cpuset);
+
+        pthread_attr_t thread_attr;
+        pthread_attr_init(&thread_attr);
+        pthread_attr_setaffinity_np(&thread_attr, sizeof(cpuset), &cpuset);
+        int ret = pthread_create(&threads[i], &thread_attr, local_thread_func, &pool);
+        pthread_attr_destroy(&thread_attr);
+        if (ret) {
+            fprintf(stderr, "[start_local] Unable to create thread\n");
+            // Уже запущенные потоки завершаются после текущей задачи.
+            atomic_store_explicit(&pool.token.requested, true, memory_order_relaxed);
+            failed = true;
+            break;
+        }
+        ++num_started;
+    }
+    for (int i = 0; i < num_started; ++i)
+        pthread_join(threads[i], NULL);
+
+    int cancelled = counting_finish(&pool.token);
+    TRACE_SPAN("local", trace_start);
+    if (failed)
+        return -1;
+    if (cancelled) {
+        fprintf(stderr, "[start_local] Time is out\n");
+        return -1;
+    }
+    return 0;
 }
 
 int init_worker(INFO_WORKER *worker, size_t size_of_structure, size_t size_of_result, 
@@ -186,6 +669,22 @@ int init_worker(INFO_WORKER *worker, size_t size_of_structure, size_t size_of_re
     worker->max_time = max_time;
     worker->size_of_structure = size_of_structure;
     worker->size_of_result = size_of_result;
+    worker->task_recv_ns = 0;
+    worker->task_start_ns = 0;
+    worker->credits = WORKER_DEFAULT_CREDITS;
+    worker->max_task_size = WORKER_DEFAULT_MAX_TASK_SIZE;
+    worker->prefetch = NULL;
+    const char *partial_ms = getenv("SPECSEM_PARTIAL_MS");
+    worker->partial_ms = partial_ms ? atol(partial_ms) : 0;
+    const char *busy_poll_us = getenv("SPECSEM_BUSY_POLL");
+    worker->busy_poll_us = busy_poll_us ? atol(busy_poll_us) : 0;
+    // Без профиля Управляющий узел не может предсказать время заданий.
+    if (profile_load(profile_path(), worker->evals_per_sec))
+        LOG_INFO("[init_worker] No calibration profile, run the worker in calibration mode");
+    // Трассировка включается переменной окружения SPECSEM_TRACE.
+    worker->trace = getenv("SPECSEM_TRACE") != NULL;
+    if (worker->trace)
+        trace_enable();
     worker->result = calloc(size_of_result, 1);
     if (!worker->result) {
         fprintf(stderr, "[init_worker] Unable to allocate memory\n");
@@ -235,7 +734,31 @@ int init_worker(INFO_WORKER *worker, size_t size_of_structure, size_t size_of_re
     return 0;
 }
 
+int worker_calibrate(INFO_WORKER *worker)
+{
+    if (!worker || worker->n_cores <= 0)
+        return -1;
+    if (profile_calibrate(worker->n_cores, worker->evals_per_sec))
+        return -1;
+    return profile_save(profile_path(), worker->evals_per_sec, worker->n_cores);
+}
+
+// Настройка сокета для режима низкой задержки; ошибки не прерывают работу.
+static void worker_set_low_latency(INFO_WORKER *worker)
+{
+    int setsockopt_arg = 1;
+    if (setsockopt(worker->server_conn_fd, IPPROTO_TCP, TCP_NODELAY, &setsockopt_arg, sizeof(setsockopt_arg)) == -1)
+        LOG_WARN("[connect_to_server] Unable to enable TCP_NODELAY socket option");
+    // Значение выше net.core.busy_read требует CAP_NET_ADMIN.
+    setsockopt_arg = worker->busy_poll_us;
+    if (setsockopt(worker->server_conn_fd, SOL_SOCKET, SO_BUSY_POLL, &setsockopt_arg, sizeof(setsockopt_arg)) == -1)
+        LOG_WARN("[connect_to_server] Unable to set SO_BUSY_POLL: %s", strerror(errno));
+}
+
 int connect_to_server(INFO_WORKER *worker) {
+    uint64_t trace_start = TRACE_START();
+    atomic_store_explicit(&worker_token.requested, false, memory_order_relaxed);
+    atomic_store_explicit(&worker_token.expired, false, memory_order_relaxed);
     // Подключение к серверу.
     bool connected_to_server = worker_connect_to_server(worker);
     while (!connected_to_server)
@@ -247,6 +770,10 @@ int connect_to_server(INFO_WORKER *worker) {
 
         connected_to_server = worker_connect_to_server(worker);
     }
+    TRACE_SPAN("connect", trace_start);
+
+    if (worker->busy_poll_us)
+        worker_set_low_latency(worker);
 
     // Отправка данных об узле.
     bool success = send_node_info(worker);
@@ -256,41 +783,133 @@ int connect_to_server(INFO_WORKER *worker) {
         return -1;
     }
 
-    // Получение данных.
-    success = get_data(worker);
-    if (!success)
+    // Задачи принимаются отдельным потоком.
+    if (!prefetch_start(worker))
     {
         worker_close_socket(worker);
         return -1;
     }
 
+    // Получение данных.
+    return get_task(worker);
+}
+
+int get_task(INFO_WORKER *worker)
+{
+    struct worker_prefetch *prefetch = worker->prefetch;
+    if (!prefetch)
+        return -1;
+    if (worker_cancelled())
+    {
+        prefetch_stop(worker);
+        return 1;
+    }
+
+    uint64_t trace_start = TRACE_START();
+    pthread_mutex_lock(&prefetch->lock);
+    if (worker->busy_poll_us) {
+        // Активное ожидание задачи перед засыпанием на условной переменной.
+        uint64_t deadline_ns = trace_now_ns() + (uint64_t)worker->busy_poll_us * 1000;
+        while (!prefetch->count && !prefetch->finished && trace_now_ns() < deadline_ns) {
+            pthread_mutex_unlock(&prefetch->lock);
+            SPIN_PAUSE();
+            pthread_mutex_lock(&prefetch->lock);
+        }
+    }
+    while (!prefetch->count && !prefetch->finished)
+        pthread_cond_wait(&prefetch->ready, &prefetch->lock);
+    struct prefetched_task task = {};
+    bool got_task = prefetch->count > 0;
+    if (got_task) {
+        task = prefetch->tasks[prefetch->head];
+        prefetch->head = (prefetch->head + 1) % prefetch->capacity;
+        prefetch->count--;
+    }
+    int finished = prefetch->finished;
+    pthread_mutex_unlock(&prefetch->lock);
+    TRACE_SPAN("wait_task", trace_start);
+
+    if (!got_task)
+    {
+        prefetch_stop(worker);
+        if (finished < 0)
+        {
+            worker_close_socket(worker);
+            return -1;
+        }
+        return 1;
+    }
+
+    free(worker->data);
+    worker->data = task.data;
+    worker->size_of_structure = task.size;
+    memset(worker->result, 0, worker->size_of_result);
+    worker->task_recv_ns = task.recv_ns;
+    worker->task_start_ns = trace_now_ns();
     return 0;
 }
 
-int send_result(INFO_WORKER *worker)
+static bool send_message(INFO_WORKER *worker, uint32_t type, const void *data, size_t size, uint32_t compute_us)
+{
+    struct msg_header header = { .type = type, .compute_us = compute_us, .size = size };
+
+    // Заголовок и данные уходят одним сегментом.
+    size_t bytes_written = send(worker->server_conn_fd, &header, sizeof(header), MSG_NOSIGNAL | (size ? MSG_MORE : 0));
+    if (bytes_written != sizeof(header))
+        return false;
+
+    bytes_written = send(worker->server_conn_fd, data, size, MSG_NOSIGNAL);
+    return bytes_written == size;
+}
+
+int send_expired(INFO_WORKER *worker)
 {
     if (!worker)
         return -1;
-
-    size_t bytes_written = write(worker->server_conn_fd, &worker->size_of_result, sizeof(worker->size_of_result));
-    if (bytes_written != sizeof(worker->size_of_result))
+    if (!send_message(worker, MSG_EXPIRED, NULL, 0, 0))
     {
-        fprintf(stderr, "Unable to send result to server\n");
+        fprintf(stderr, "Unable to return expired task to server\n");
         return -1;
     }
+    return 0;
+}
+
+int send_result(INFO_WORKER *worker)
+{
+    if (!worker)
+        return -1;
+
+    uint64_t trace_start = TRACE_START();
+    if (worker->trace) {
+        // События уходят перед ответом, чтобы Управляющий узел получил их до следующей задачи.
+        size_t size = 0;
+        struct trace_block *block = trace_collect(worker->task_recv_ns, &size);
+        if (block) {
+            bool success = send_message(worker, MSG_TRACE, block, size, 0);
+            free(block);
+            if (!success) {
+                fprintf(stderr, "Unable to send trace to server\n");
+                return -1;
+            }
+        }
+    }
 
-    bytes_written = write(worker->server_conn_fd, worker->result, worker->size_of_result);
-    if (bytes_written != worker->size_of_result)
+    // Время вычисления для метрик Управляющего узла (не меньше 1 мкс, 0 означает "неизвестно").
+    uint64_t compute_us = (trace_now_ns() - worker->task_start_ns) / 1000;
+    compute_us = compute_us < 1 ? 1 : compute_us > UINT32_MAX ? UINT32_MAX : compute_us;
+    if (!send_message(worker, MSG_ANSWER, worker->result, worker->size_of_result, compute_us))
     {
         fprintf(stderr, "Unable to send result to server\n");
         return -1;
     }
+    TRACE_SPAN("send_result", trace_start);
     return 0;
 }
 
 void worker_close(INFO_WORKER *worker)
 {
     printf("[worker_close]\n");
+    prefetch_stop(worker);
     // Освобождение сокета.
     if (worker->server_conn_fd >= 0)
         worker_close_socket(worker);
@@ -1,8 +1,24 @@
+#ifndef WORKER_H
+#define WORKER_H
+
 //================
 // Данные исполнителя.
 //================
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/socket.h>
 
+#include "common.h"
+
+// Кредиты по умолчанию: одна задача выполняется, ещё одна принимается заранее.
+#define WORKER_DEFAULT_CREDITS 2
+
+// Наибольший размер задачи по умолчанию: задачи крупнее считаются ошибкой протокола.
+#define WORKER_DEFAULT_MAX_TASK_SIZE (64UL << 20)
+
+struct worker_prefetch;
+
 typedef struct
 {
     // Дескриптор сокета для подключения к серверу.
@@ -11,7 +27,8 @@ typedef struct
     // Адрес для подключению к серверу.
     struct sockaddr server_addr;
 
-    // Максимальное время вычисления.
+    // Максимальное время вычисления одной задачи в секундах (0 - без ограничения);
+    // по его истечении выставляется токен отмены.
     time_t max_time;
 
     // Количество ядер.
@@ -28,6 +45,42 @@ typedef struct
 
     // Результат вычислений.
     char *result;
+
+    // Передавать ли события трассировки Управляющему узлу.
+    bool trace;
+
+    // Время получения текущей задачи (для выравнивания часов при трассировке).
+    uint64_t task_recv_ns;
+
+    // Время начала вычисления текущей задачи (передаётся с ответом как время вычисления).
+    uint64_t task_start_ns;
+
+    // Кредиты: сколько задач узел держит у себя одновременно, включая выполняемую
+    // (по умолчанию WORKER_DEFAULT_CREDITS; можно изменить до connect_to_server).
+    uint32_t credits;
+
+    // Наибольший размер принимаемой задачи в байтах: размер приходит из сети и без проверки
+    // выделялся бы как есть (по умолчанию WORKER_DEFAULT_MAX_TASK_SIZE; можно изменить
+    // до connect_to_server, например для крупных пакетов batch).
+    size_t max_task_size;
+
+    // Очередь заранее принятых задач, заполняемая потоком приёма.
+    struct worker_prefetch *prefetch;
+
+    // Период отправки промежуточных результатов в миллисекундах (0 - не отправлять);
+    // начальное значение берётся из переменной окружения SPECSEM_PARTIAL_MS.
+    uint32_t partial_ms;
+
+    // Режим низкой задержки: время активного ожидания задачи в микросекундах, после которого
+    // поток засыпает (0 - режим выключен). Поток приёма закрепляется за первым ядром после
+    // ядер вычисления, сокет получает SO_BUSY_POLL и TCP_NODELAY; начальное значение берётся
+    // из переменной окружения SPECSEM_BUSY_POLL (задаётся до connect_to_server).
+    uint32_t busy_poll_us;
+
+    // Профиль узла: вычислений каждой функции FUNC_TABLE в секунду на одно ядро (0 - неизвестно).
+    // Загружается init_worker из файла profile_path() и передаётся Управляющему узлу при подключении
+    // для планирования заданий; файл создаётся worker_calibrate.
+    double evals_per_sec[NOT_SUPPORT];
 } INFO_WORKER;
 
 
@@ -39,21 +92,86 @@ typedef struct
 int init_worker(INFO_WORKER *worker, size_t size_of_structure, size_t size_of_result, 
         int n_cores, time_t max_time, char *node, char *service);
 
-// Подключение к серверу
+// Калибровка ядер вычислений на n_cores ядрах: профиль записывается в evals_per_sec
+// и сохраняется в файл profile_path(). Возвращает 0 в случае успеха и -1 при ошибке.
+int worker_calibrate(INFO_WORKER *worker);
+
+// Подключение к серверу, запуск потока приёма задач и получение первой задачи.
+// Возвращает 0, если задача получена, 1, если задач нет, и -1 при ошибке.
 int connect_to_server(INFO_WORKER *worker);
 
-// Распределение вычисления по ядрам
+// Получение следующей задачи после отправки результата.
+// Возвращает 0, если задача получена, 1, если задач больше нет, и -1 при ошибке.
+int get_task(INFO_WORKER *worker);
+
+// Распределение вычисления по ядрам.
+// Возвращает 0 при успехе, 1, если вычисление отменено (результат не отправляется), 2, если истёк
+// max_time задачи (задача возвращается Управляющему узлу через send_expired), и -1 при ошибке.
 int distributed_counting(INFO_WORKER *worker, void*(thread_func(void*)));
 
-// Добавление результата одного потока
+//================
+// Отмена вычисления.
+//================
+// Ядра вычислений проверяют токен отмены раз в WORKER_CANCEL_BLOCK итераций (степень двойки)
+// и при отмене завершаются досрочно. Токен выставляется сообщением отмены от Управляющего узла
+// и сбрасывается при подключении к серверу. Истечение max_time прерывает ядра так же, но относится
+// только к текущей задаче: distributed_counting возвращает 2, и узел продолжает работу.
+#define WORKER_CANCEL_BLOCK 16384
+
+// Выставление токена отмены.
+void worker_cancel(void);
+
+// Проверка токена отмены и крайнего срока текущей задачи.
+bool worker_cancelled(void);
+
+//================
+// Промежуточные результаты.
+//================
+// Ядро вычислений сообщает оценку результата своей части задачи; раз в partial_ms поток
+// распределения складывает оценки всех потоков и отправляет их Управляющему узлу, который
+// по истечении max_time может вернуть оценку вместо ошибки. Вне потоков distributed_counting
+// и при partial_ms == 0 вызов ничего не делает.
+void worker_partial(double value, double error, double coverage);
+
+// Добавление результата одного потока (в потоке пула start_local - к результату его задачи).
 void worker_add_result(INFO_WORKER *worker, char *result, void(add_func(char*, char*)));
 
+//================
+// Локальное выполнение.
+//================
+/*!
+ * \brief Функция для выполнения задач в текущем процессе, без Управляющего узла и сокетов.
+ *
+ * \param[in] size_of_structure, num_tasks, tasks Задачи, как для start_manager.
+ * \param[out] ans Область для num_tasks результатов по size_of_result байт.
+ * \param[in] n_threads Количество потоков пула (не больше количества ядер).
+ * \param[in] max_time Максимальное время работы в секундах (0 - без ограничения).
+ * \param[in] thread_func Функция потока рабочего узла; получает задачу целиком.
+ *
+ * \return 0 в случае успеха, -1 при ошибке или истечении max_time.
+ *
+ * \details Потоки пула закреплены за ядрами и забирают задачи атомарным счётчиком без блокировок;
+ *          задачи передаются указателем, без копирования. Результат каждой задачи обнуляется
+ *          перед вычислением, worker_add_result в потоке пула добавляет к нему результат, а сам
+ *          результат записывается в ans на место задачи (в порядке задач, а не получения).
+ *          У пула свой токен отмены и крайний срок, которые проверяются теми же worker_cancelled
+ *          и worker_cancel в его потоках; токен рабочего узла в том же процессе не затрагивается.
+ */
+int start_local(size_t size_of_structure, size_t size_of_result, size_t num_tasks, char *tasks, char *ans,
+        int n_threads, time_t max_time, void*(thread_func(void*)));
+
 // Отправка результата серверу
 int send_result(INFO_WORKER *worker);
 
+// Возврат выполняемой задачи серверу, если истёк её max_time (distributed_counting вернула 2):
+// задача достанется другому узлу, а узел получит следующую.
+int send_expired(INFO_WORKER *worker);
+
 // Закрытие открытого сокета
 void worker_close(INFO_WORKER *worker);
 
 #if defined(TEST)
 void test(void);
 #endif
+
+#endif // WORKER_H
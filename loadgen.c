@@ -0,0 +1,481 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lib/common.h"
+
+// Генератор нагрузки: множество лёгких поддельных рабочих узлов.
+// Каждое соединение проходит рукопожатие, принимает задачи и отвечает на них
+// через случайную задержку, не выполняя вычислений. Измеряется время от отправки
+// ответа до получения следующей задачи, то есть скорость работы самого Управляющего узла.
+
+//============================
+// Параметры нагрузки
+//============================
+
+typedef enum
+{
+    DELAY_FIXED,
+    DELAY_UNIFORM,
+    DELAY_EXP,
+} DELAY_KIND;
+
+struct delay_spec {
+    DELAY_KIND kind;
+    // Параметры в микросекундах: fixed - a, uniform - [a, b], exp - среднее a.
+    double a;
+    double b;
+};
+
+struct delay_spec DELAY = { DELAY_FIXED, 0, 0 };
+// Размер ответа: число double (Управляющий узел суммирует их как результаты).
+size_t ANSWER_SIZE = sizeof(double);
+struct sockaddr_storage ADDR;
+socklen_t ADDR_LEN;
+
+//============================
+// Состояние соединений
+//============================
+
+typedef enum
+{
+    CONN_CONNECTING,
+    CONN_READ_SIZE,
+    CONN_READ_BODY,
+    CONN_DELAY,
+    CONN_DONE,
+} CONN_STATE;
+
+struct fake_conn {
+    int fd;
+    CONN_STATE state;
+    // Приём задачи: размер и количество уже прочитанных байт.
+    size_t size;
+    size_t got;
+    // Время отправки последнего ответа (0 - ответов ещё не было).
+    uint64_t answer_sent_ns;
+};
+
+struct timer {
+    uint64_t deadline_ns;
+    size_t conn_i;
+};
+
+struct load_thread {
+    pthread_t thread;
+    size_t first_conn;
+    size_t num_conns;
+    struct fake_conn *conns;
+    int epoll_fd;
+    // Куча таймеров задержки ответа.
+    struct timer *timers;
+    size_t num_timers;
+    uint64_t rng;
+    // Задержки диспетчеризации в наносекундах.
+    uint64_t *latencies;
+    size_t num_latencies;
+    size_t cap_latencies;
+    uint64_t tasks;
+    uint64_t errors;
+    size_t active;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double rng_next(struct load_thread *lt)
+{
+    // xorshift64*
+    lt->rng ^= lt->rng >> 12;
+    lt->rng ^= lt->rng << 25;
+    lt->rng ^= lt->rng >> 27;
+    return ((lt->rng * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+static uint64_t delay_ns(struct load_thread *lt)
+{
+    double us;
+    switch (DELAY.kind) {
+    case DELAY_UNIFORM:
+        us = DELAY.a + (DELAY.b - DELAY.a) * rng_next(lt);
+        break;
+    case DELAY_EXP:
+        us = -DELAY.a * log(1 - rng_next(lt));
+        break;
+    default:
+        us = DELAY.a;
+    }
+    return (uint64_t)(us * 1000);
+}
+
+static void timer_push(struct load_thread *lt, uint64_t deadline_ns, size_t conn_i)
+{
+    size_t i = lt->num_timers++;
+    while (i > 0 && lt->timers[(i - 1) / 2].deadline_ns > deadline_ns) {
+        lt->timers[i] = lt->timers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    lt->timers[i] = (struct timer){ deadline_ns, conn_i };
+}
+
+static struct timer timer_pop(struct load_thread *lt)
+{
+    struct timer top = lt->timers[0];
+    struct timer last = lt->timers[--lt->num_timers];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= lt->num_timers)
+            break;
+        if (child + 1 < lt->num_timers && lt->timers[child + 1].deadline_ns < lt->timers[child].deadline_ns)
+            ++child;
+        if (last.deadline_ns <= lt->timers[child].deadline_ns)
+            break;
+        lt->timers[i] = lt->timers[child];
+        i = child;
+    }
+    lt->timers[i] = last;
+    return top;
+}
+
+static void record_latency(struct load_thread *lt, uint64_t latency)
+{
+    if (lt->num_latencies == lt->cap_latencies) {
+        size_t cap = lt->cap_latencies ? 2 * lt->cap_latencies : 4096;
+        uint64_t *latencies = realloc(lt->latencies, cap * sizeof(*latencies));
+        if (!latencies)
+            return;
+        lt->latencies = latencies;
+        lt->cap_latencies = cap;
+    }
+    lt->latencies[lt->num_latencies++] = latency;
+}
+
+static void conn_finish(struct load_thread *lt, struct fake_conn *conn, bool error)
+{
+    if (conn->state == CONN_DONE)
+        return;
+    if (error)
+        ++lt->errors;
+    epoll_ctl(lt->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->state = CONN_DONE;
+    --lt->active;
+}
+
+//============================
+// Протокол рабочего узла
+//============================
+
+static bool conn_handshake(struct fake_conn *conn)
+{
+    // Один кредит: ответ на задачу и приём следующей чередуются.
+    struct node_info info = { .n_cores = 1, .credits = 1 };
+    return send(conn->fd, &info, sizeof(info), MSG_NOSIGNAL) == sizeof(info);
+}
+
+static bool conn_answer(struct load_thread *lt, struct fake_conn *conn)
+{
+    char buf[sizeof(struct msg_header) + 4096] = {};
+    struct msg_header header = { .type = MSG_ANSWER, .compute_us = 0, .size = ANSWER_SIZE };
+    memcpy(buf, &header, sizeof(header));
+
+    size_t size = sizeof(header) + ANSWER_SIZE;
+    if (send(conn->fd, buf, size, MSG_NOSIGNAL) != (ssize_t)size)
+        return false;
+    conn->answer_sent_ns = now_ns();
+    conn->state = CONN_READ_SIZE;
+    conn->got = 0;
+    ++lt->tasks;
+    return true;
+}
+
+// Чтение задачи; содержимое задачи не используется.
+static void conn_readable(struct load_thread *lt, size_t conn_i)
+{
+    struct fake_conn *conn = &lt->conns[conn_i];
+    char scratch[65536];
+
+    for (;;) {
+        ssize_t ret;
+        if (conn->state == CONN_READ_SIZE) {
+            ret = recv(conn->fd, (char *)&conn->size + conn->got, sizeof(conn->size) - conn->got, 0);
+        } else if (conn->state == CONN_READ_BODY) {
+            size_t left = conn->size - conn->got;
+            ret = recv(conn->fd, scratch, left < sizeof(scratch) ? left : sizeof(scratch), 0);
+        } else {
+            return;
+        }
+
+        if (ret == 0) {
+            conn_finish(lt, conn, true);
+            return;
+        }
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                conn_finish(lt, conn, true);
+            return;
+        }
+        conn->got += ret;
+
+        if (conn->state == CONN_READ_SIZE && conn->got == sizeof(conn->size)) {
+            if (conn->size == TASK_SIZE_END || conn->size == TASK_SIZE_CANCEL) {
+                // Задач больше нет или задание отменено.
+                conn_finish(lt, conn, false);
+                return;
+            }
+            conn->state = CONN_READ_BODY;
+        }
+        if (conn->state == CONN_READ_BODY && conn->got == conn->size) {
+            uint64_t now = now_ns();
+            if (conn->answer_sent_ns)
+                record_latency(lt, now - conn->answer_sent_ns);
+            conn->state = CONN_DELAY;
+            timer_push(lt, now + delay_ns(lt), conn_i);
+            return;
+        }
+    }
+}
+
+static void *load_thread_func(void *t_args)
+{
+    struct load_thread *lt = (struct load_thread *)t_args;
+    struct epoll_event events[256];
+
+    for (size_t i = 0; i < lt->num_conns; ++i) {
+        struct fake_conn *conn = &lt->conns[i];
+        conn->fd = socket(ADDR.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (conn->fd == -1) {
+            fprintf(stderr, "[loadgen] Unable to create socket: %s\n", strerror(errno));
+            conn->state = CONN_DONE;
+            ++lt->errors;
+            continue;
+        }
+        int arg = 1;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &arg, sizeof(arg));
+        conn->state = CONN_CONNECTING;
+        if (connect(conn->fd, (struct sockaddr *)&ADDR, ADDR_LEN) == -1 && errno != EINPROGRESS) {
+            close(conn->fd);
+            conn->state = CONN_DONE;
+            ++lt->errors;
+            continue;
+        }
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.u64 = i };
+        epoll_ctl(lt->epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev);
+        ++lt->active;
+    }
+
+    while (lt->active) {
+        int timeout_ms = -1;
+        if (lt->num_timers) {
+            uint64_t now = now_ns();
+            uint64_t deadline = lt->timers[0].deadline_ns;
+            timeout_ms = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+        }
+
+        int n = epoll_wait(lt->epoll_fd, events, 256, timeout_ms);
+        if (n == -1 && errno != EINTR) {
+            fprintf(stderr, "[loadgen] epoll_wait failed\n");
+            break;
+        }
+
+        for (int e = 0; e < n; ++e) {
+            size_t conn_i = events[e].data.u64;
+            struct fake_conn *conn = &lt->conns[conn_i];
+            if (conn->state == CONN_CONNECTING && (events[e].events & EPOLLOUT)) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err || !conn_handshake(conn)) {
+                    conn_finish(lt, conn, true);
+                    continue;
+                }
+                struct epoll_event ev = { .events = EPOLLIN, .data.u64 = conn_i };
+                epoll_ctl(lt->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+                conn->state = CONN_READ_SIZE;
+                conn->got = 0;
+            }
+            if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                conn_readable(lt, conn_i);
+        }
+
+        uint64_t now = now_ns();
+        while (lt->num_timers && lt->timers[0].deadline_ns <= now) {
+            struct timer timer = timer_pop(lt);
+            struct fake_conn *conn = &lt->conns[timer.conn_i];
+            if (conn->state != CONN_DELAY)
+                continue;
+            if (!conn_answer(lt, conn)) {
+                conn_finish(lt, conn, true);
+                continue;
+            }
+            // Следующая задача могла прийти сразу за ответом.
+            conn_readable(lt, timer.conn_i);
+        }
+    }
+    return NULL;
+}
+
+//============================
+// Разбор аргументов и отчёт
+//============================
+
+static bool parse_delay(const char *spec)
+{
+    if (sscanf(spec, "fixed:%lf", &DELAY.a) == 1) {
+        DELAY.kind = DELAY_FIXED;
+        return DELAY.a >= 0;
+    }
+    if (sscanf(spec, "uniform:%lf:%lf", &DELAY.a, &DELAY.b) == 2) {
+        DELAY.kind = DELAY_UNIFORM;
+        return DELAY.a >= 0 && DELAY.b >= DELAY.a;
+    }
+    if (sscanf(spec, "exp:%lf", &DELAY.a) == 1) {
+        DELAY.kind = DELAY_EXP;
+        return DELAY.a >= 0;
+    }
+    return false;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint64_t *sorted, size_t n, double p)
+{
+    if (!n)
+        return 0;
+    size_t i = (size_t)ceil(p * n);
+    return sorted[i ? i - 1 : 0] / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5 || argc > 7) {
+        fprintf(stderr, "Usage: %s <address> <port> <connections> <threads> "
+                "[fixed:US|uniform:MIN_US:MAX_US|exp:MEAN_US] [answer_doubles]\n", argv[0]);
+        return 1;
+    }
+    size_t num_conns = atol(argv[3]);
+    size_t num_threads = atol(argv[4]);
+    if (!num_conns || !num_threads) {
+        fprintf(stderr, "Number of connections and threads should be positive!\n");
+        return 1;
+    }
+    if (num_threads > num_conns)
+        num_threads = num_conns;
+    if (argc >= 6 && !parse_delay(argv[5])) {
+        fprintf(stderr, "Wrong delay distribution: %s\n", argv[5]);
+        return 1;
+    }
+    if (argc == 7) {
+        ANSWER_SIZE = atol(argv[6]) * sizeof(double);
+        if (ANSWER_SIZE > 4096) {
+            fprintf(stderr, "Answer is too large\n");
+            return 1;
+        }
+    }
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(argv[1], argv[2], &hints, &res)) {
+        fprintf(stderr, "Unable to resolve %s:%s\n", argv[1], argv[2]);
+        return 1;
+    }
+    memcpy(&ADDR, res->ai_addr, res->ai_addrlen);
+    ADDR_LEN = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    // Десятки тысяч соединений требуют поднять ограничение на число дескрипторов.
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < num_conns + 64) {
+        rl.rlim_cur = rl.rlim_max < num_conns + 64 ? rl.rlim_max : num_conns + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    struct fake_conn *conns = calloc(num_conns, sizeof(*conns));
+    struct timer *timers = calloc(num_conns, sizeof(*timers));
+    struct load_thread *threads = calloc(num_threads, sizeof(*threads));
+    if (!conns || !timers || !threads) {
+        fprintf(stderr, "Unable to allocate memory\n");
+        return 1;
+    }
+
+    uint64_t start_ns = now_ns();
+    size_t first = 0;
+    for (size_t t = 0; t < num_threads; ++t) {
+        struct load_thread *lt = &threads[t];
+        lt->first_conn = first;
+        lt->num_conns = num_conns / num_threads + (t < num_conns % num_threads);
+        lt->conns = conns + first;
+        lt->timers = timers + first;
+        lt->rng = 0x9E3779B97F4A7C15ULL * (t + 1);
+        lt->epoll_fd = epoll_create1(0);
+        first += lt->num_conns;
+        if (lt->epoll_fd == -1 || pthread_create(&lt->thread, NULL, load_thread_func, lt)) {
+            fprintf(stderr, "Unable to start load thread\n");
+            return 1;
+        }
+    }
+
+    uint64_t tasks = 0, errors = 0;
+    size_t num_latencies = 0;
+    for (size_t t = 0; t < num_threads; ++t) {
+        pthread_join(threads[t].thread, NULL);
+        tasks += threads[t].tasks;
+        errors += threads[t].errors;
+        num_latencies += threads[t].num_latencies;
+    }
+    double elapsed = (now_ns() - start_ns) / 1e9;
+
+    uint64_t *latencies = calloc(num_latencies + 1, sizeof(*latencies));
+    if (!latencies) {
+        fprintf(stderr, "Unable to allocate memory\n");
+        return 1;
+    }
+    size_t n = 0;
+    for (size_t t = 0; t < num_threads; ++t) {
+        memcpy(latencies + n, threads[t].latencies, threads[t].num_latencies * sizeof(*latencies));
+        n += threads[t].num_latencies;
+        free(threads[t].latencies);
+        close(threads[t].epoll_fd);
+    }
+    qsort(latencies, n, sizeof(*latencies), cmp_u64);
+
+    printf("Connections: %lu (errors: %lu)\n", num_conns, errors);
+    printf("Tasks answered: %lu in %.3f s\n", tasks, elapsed);
+    printf("Dispatch throughput: %.1f tasks/s\n", elapsed > 0 ? tasks / elapsed : 0);
+    printf("Dispatch latency (answer -> next task), us: p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+            percentile_us(latencies, n, 0.5), percentile_us(latencies, n, 0.9),
+            percentile_us(latencies, n, 0.99), percentile_us(latencies, n, 0.999),
+            n ? latencies[n - 1] / 1000.0 : 0);
+
+    free(latencies);
+    free(threads);
+    free(timers);
+    free(conns);
+    return 0;
+}
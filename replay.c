@@ -0,0 +1,679 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lib/common.h"
+#include "lib/record.h"
+
+// Воспроизведение записи протокола (SPECSEM_RECORD) против Управляющего узла.
+// Для каждого записанного соединения открывается поддельный рабочий узел: он подключается
+// в записанный момент, передаёт записанные ядра и кредиты и на каждую задачу отправляет
+// записанные сообщения (промежуточные результаты, трассировку, ответ) с записанными задержками
+// от начала выполнения задачи и записанных размеров. Узел, отключившийся при записи,
+// отключается после того же числа задач. Если новый Управляющий узел выдаёт соединению больше
+// задач, чем при записи, сценарии выполненных задач повторяются по кругу.
+// Скорость: 1 - как при записи, k - в k раз быстрее, 0 - без задержек.
+
+//============================
+// Сценарии соединений
+//============================
+
+struct replay_msg {
+    // Задержка от начала выполнения задачи.
+    uint64_t offset_ns;
+    uint32_t type;
+    uint32_t compute_us;
+    uint64_t size;
+};
+
+typedef enum
+{
+    CONN_WAIT_CONNECT,
+    CONN_CONNECTING,
+    CONN_READY,
+    CONN_DONE,
+} CONN_STATE;
+
+struct replay_conn {
+    // Запись: время подключения, данные узла и сообщения по задачам.
+    uint64_t connect_ns;
+    bool has_info;
+    struct node_info info;
+    struct replay_msg *msgs;
+    size_t num_msgs;
+    size_t cap_msgs;
+    // Номер первого сообщения каждой задачи; последняя задача без ответа - задача отключения.
+    size_t *scripts;
+    size_t num_scripts;
+    size_t cap_scripts;
+    size_t num_answered;
+    // Отключение: после drop_task задач, через drop_offset_ns от начала задачи (drop_busy)
+    // или от последнего ответа.
+    bool drops;
+    bool drop_busy;
+    size_t drop_task;
+    uint64_t drop_offset_ns;
+
+    // Воспроизведение.
+    int fd;
+    CONN_STATE state;
+    // Приём задачи: размер и количество уже прочитанных байт.
+    size_t size;
+    size_t got;
+    bool reading_body;
+    // Принятые и ещё не начатые задачи.
+    size_t queued;
+    // Выполняемая задача: номер по порядку, сценарий и следующее сообщение.
+    bool busy;
+    size_t task_k;
+    size_t script;
+    size_t next_msg;
+    uint64_t task_start_ns;
+    uint64_t due_ns;
+    uint64_t drop_ns;
+    uint64_t answer_sent_ns;
+};
+
+typedef enum
+{
+    TIMER_ACTION,
+    TIMER_DROP,
+} TIMER_KIND;
+
+struct timer {
+    uint64_t deadline_ns;
+    size_t conn_i;
+    TIMER_KIND kind;
+};
+
+struct replay {
+    struct replay_conn *conns;
+    size_t num_conns;
+    int epoll_fd;
+    struct timer *timers;
+    size_t num_timers;
+    size_t cap_timers;
+    uint64_t start_ns;
+    double speed;
+    // Задержки диспетчеризации в наносекундах.
+    uint64_t *latencies;
+    size_t num_latencies;
+    size_t cap_latencies;
+    uint64_t tasks;
+    uint64_t errors;
+    size_t active;
+};
+
+struct sockaddr_storage ADDR;
+socklen_t ADDR_LEN;
+// Размер ответа для задач соединения без записанных ответов.
+#define DEFAULT_ANSWER_SIZE sizeof(double)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool grow(void **array, size_t *cap, size_t count, size_t item_size)
+{
+    if (count < *cap)
+        return true;
+    size_t new_cap = *cap ? 2 * *cap : 16;
+    void *new_array = realloc(*array, new_cap * item_size);
+    if (!new_array)
+        return false;
+    *array = new_array;
+    *cap = new_cap;
+    return true;
+}
+
+//============================
+// Чтение записи
+//============================
+
+// Состояние разбора одного соединения.
+struct parse_conn {
+    // Время отправки задач, ещё не начатых узлом.
+    uint64_t *sent;
+    size_t num_sent;
+    size_t cap_sent;
+    size_t next_sent;
+    // Начало выполняемой задачи (0 - узел свободен) и время последнего ответа.
+    uint64_t task_start_ns;
+    uint64_t idle_since_ns;
+};
+
+static struct replay_conn *conn_get(struct replay *rp, struct parse_conn **parse, size_t *cap, uint32_t id)
+{
+    if (id >= *cap) {
+        size_t new_cap = *cap ? *cap : 16;
+        while (new_cap <= id)
+            new_cap *= 2;
+        struct replay_conn *conns = realloc(rp->conns, new_cap * sizeof(*conns));
+        struct parse_conn *new_parse = realloc(*parse, new_cap * sizeof(**parse));
+        if (conns)
+            rp->conns = conns;
+        if (new_parse)
+            *parse = new_parse;
+        if (!conns || !new_parse)
+            return NULL;
+        memset(rp->conns + *cap, 0, (new_cap - *cap) * sizeof(*conns));
+        memset(*parse + *cap, 0, (new_cap - *cap) * sizeof(**parse));
+        *cap = new_cap;
+    }
+    if (id >= rp->num_conns)
+        rp->num_conns = id + 1;
+    return &rp->conns[id];
+}
+
+// Начало следующей отправленной задачи, если узел свободен.
+static void parse_start_task(struct replay_conn *conn, struct parse_conn *pc, uint64_t ts)
+{
+    if (pc->task_start_ns || pc->next_sent == pc->num_sent)
+        return;
+    uint64_t sent = pc->sent[pc->next_sent++];
+    pc->task_start_ns = sent > pc->idle_since_ns ? sent : pc->idle_since_ns;
+    if (pc->task_start_ns > ts)
+        pc->task_start_ns = ts;
+    if (grow((void **)&conn->scripts, &conn->cap_scripts, conn->num_scripts, sizeof(*conn->scripts)))
+        conn->scripts[conn->num_scripts++] = conn->num_msgs;
+}
+
+static int load_record(struct replay *rp, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return -1;
+    }
+    struct record_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) ||
+            header.event_size != sizeof(struct record_event)) {
+        fprintf(stderr, "%s is not a protocol record\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    struct parse_conn *parse = NULL;
+    size_t cap = 0;
+    struct record_event event;
+    int ret = 0;
+    while (fread(&event, sizeof(event), 1, file) == 1) {
+        struct parse_conn *pc;
+        struct replay_conn *conn = conn_get(rp, &parse, &cap, event.conn);
+        if (!conn) {
+            ret = -1;
+            break;
+        }
+        pc = &parse[event.conn];
+
+        switch (event.type) {
+        case RECORD_CONNECT:
+            conn->connect_ns = event.ts_ns;
+            pc->idle_since_ns = event.ts_ns;
+            break;
+        case RECORD_INFO:
+            conn->has_info = true;
+            conn->info.n_cores = event.arg0;
+            conn->info.credits = event.arg1;
+            pc->idle_since_ns = event.ts_ns;
+            break;
+        case RECORD_TASK:
+            if (grow((void **)&pc->sent, &pc->cap_sent, pc->num_sent, sizeof(*pc->sent)))
+                pc->sent[pc->num_sent++] = event.ts_ns;
+            break;
+        case RECORD_MESSAGE:
+            parse_start_task(conn, pc, event.ts_ns);
+            if (!pc->task_start_ns)
+                break;
+            if (!grow((void **)&conn->msgs, &conn->cap_msgs, conn->num_msgs, sizeof(*conn->msgs))) {
+                ret = -1;
+                break;
+            }
+            conn->msgs[conn->num_msgs++] = (struct replay_msg){
+                .offset_ns = event.ts_ns - pc->task_start_ns,
+                .type = event.msg_type,
+                .compute_us = event.arg0,
+                .size = event.size,
+            };
+            // Возврат задачи по истечении срока узла завершает её так же, как ответ.
+            if (event.msg_type == MSG_ANSWER || event.msg_type == MSG_EXPIRED) {
+                conn->num_answered++;
+                pc->task_start_ns = 0;
+                pc->idle_since_ns = event.ts_ns;
+            }
+            break;
+        case RECORD_DISCONNECT:
+            parse_start_task(conn, pc, event.ts_ns);
+            conn->drops = true;
+            conn->drop_task = conn->num_answered;
+            conn->drop_busy = pc->task_start_ns != 0;
+            conn->drop_offset_ns = event.ts_ns - (conn->drop_busy ? pc->task_start_ns : pc->idle_since_ns);
+            break;
+        default:
+            break;
+        }
+        if (ret)
+            break;
+    }
+    for (size_t i = 0; i < cap; ++i)
+        free(parse[i].sent);
+    free(parse);
+    fclose(file);
+    return ret;
+}
+
+//============================
+// Воспроизведение
+//============================
+
+static uint64_t scaled(const struct replay *rp, uint64_t ns)
+{
+    return rp->speed > 0 ? (uint64_t)(ns / rp->speed) : 0;
+}
+
+static void timer_push(struct replay *rp, uint64_t deadline_ns, size_t conn_i, TIMER_KIND kind)
+{
+    if (!grow((void **)&rp->timers, &rp->cap_timers, rp->num_timers, sizeof(*rp->timers))) {
+        ++rp->errors;
+        return;
+    }
+    size_t i = rp->num_timers++;
+    while (i > 0 && rp->timers[(i - 1) / 2].deadline_ns > deadline_ns) {
+        rp->timers[i] = rp->timers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    rp->timers[i] = (struct timer){ deadline_ns, conn_i, kind };
+}
+
+static struct timer timer_pop(struct replay *rp)
+{
+    struct timer top = rp->timers[0];
+    struct timer last = rp->timers[--rp->num_timers];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= rp->num_timers)
+            break;
+        if (child + 1 < rp->num_timers && rp->timers[child + 1].deadline_ns < rp->timers[child].deadline_ns)
+            ++child;
+        if (last.deadline_ns <= rp->timers[child].deadline_ns)
+            break;
+        rp->timers[i] = rp->timers[child];
+        i = child;
+    }
+    rp->timers[i] = last;
+    return top;
+}
+
+static void record_latency(struct replay *rp, uint64_t latency)
+{
+    if (grow((void **)&rp->latencies, &rp->cap_latencies, rp->num_latencies, sizeof(*rp->latencies)))
+        rp->latencies[rp->num_latencies++] = latency;
+}
+
+static void conn_finish(struct replay *rp, struct replay_conn *conn, bool error)
+{
+    if (conn->state == CONN_DONE)
+        return;
+    if (error)
+        ++rp->errors;
+    if (conn->fd >= 0) {
+        epoll_ctl(rp->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+        close(conn->fd);
+    }
+    conn->fd = -1;
+    conn->state = CONN_DONE;
+    --rp->active;
+}
+
+static bool send_all(int fd, const void *data, size_t size)
+{
+    const char *p = data;
+    while (size) {
+        ssize_t sent = send(fd, p, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return false;
+        p += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+static bool send_msg(struct replay_conn *conn, uint32_t type, uint32_t compute_us, uint64_t size)
+{
+    static const char zeros[65536];
+    struct msg_header header = { .type = type, .compute_us = compute_us, .size = size };
+    if (!send_all(conn->fd, &header, sizeof(header)))
+        return false;
+    // Содержимое не записывается: отправляются нули нужного размера.
+    while (size) {
+        size_t part = size < sizeof(zeros) ? size : sizeof(zeros);
+        if (!send_all(conn->fd, zeros, part))
+            return false;
+        size -= part;
+    }
+    return true;
+}
+
+static void conn_schedule_drop(struct replay *rp, size_t conn_i, uint64_t from_ns)
+{
+    struct replay_conn *conn = &rp->conns[conn_i];
+    conn->drop_ns = from_ns + scaled(rp, conn->drop_offset_ns);
+    timer_push(rp, conn->drop_ns, conn_i, TIMER_DROP);
+}
+
+// Выбор сценария для task_k-й задачи: записанный либо один из выполненных по кругу.
+static bool conn_pick_script(struct replay_conn *conn, size_t task_k, size_t *script)
+{
+    if (task_k < conn->num_scripts) {
+        *script = task_k;
+        return true;
+    }
+    if (!conn->num_answered)
+        return false;
+    *script = (task_k - conn->num_scripts) % conn->num_answered;
+    return true;
+}
+
+static void conn_start_task(struct replay *rp, size_t conn_i)
+{
+    struct replay_conn *conn = &rp->conns[conn_i];
+    if (conn->busy || !conn->queued || conn->state != CONN_READY)
+        return;
+    conn->queued--;
+    conn->busy = true;
+    conn->task_start_ns = now_ns();
+    conn->next_msg = 0;
+    if (!conn_pick_script(conn, conn->task_k, &conn->script))
+        conn->script = SIZE_MAX;
+    if (conn->drops && conn->drop_busy && conn->task_k == conn->drop_task)
+        conn_schedule_drop(rp, conn_i, conn->task_start_ns);
+    conn->task_k++;
+
+    uint64_t offset = 0;
+    if (conn->script != SIZE_MAX && conn->scripts[conn->script] < conn->num_msgs)
+        offset = conn->msgs[conn->scripts[conn->script]].offset_ns;
+    conn->due_ns = conn->task_start_ns + scaled(rp, offset);
+    timer_push(rp, conn->due_ns, conn_i, TIMER_ACTION);
+}
+
+// Отправка очередного сообщения выполняемой задачи.
+static void conn_action(struct replay *rp, size_t conn_i)
+{
+    struct replay_conn *conn = &rp->conns[conn_i];
+    if (!conn->busy)
+        return;
+
+    struct replay_msg fallback = { .type = MSG_ANSWER, .size = DEFAULT_ANSWER_SIZE };
+    const struct replay_msg *msg = &fallback;
+    const struct replay_msg *next = NULL;
+    if (conn->script != SIZE_MAX) {
+        size_t first = conn->scripts[conn->script];
+        size_t end = conn->script + 1 < conn->num_scripts ? conn->scripts[conn->script + 1] : conn->num_msgs;
+        if (first + conn->next_msg >= end)
+            return; // Задача отключения: узел ждёт своего отключения.
+        msg = &conn->msgs[first + conn->next_msg++];
+        if (first + conn->next_msg < end)
+            next = &conn->msgs[first + conn->next_msg];
+    }
+
+    if (!send_msg(conn, msg->type, msg->compute_us, msg->size)) {
+        conn_finish(rp, conn, true);
+        return;
+    }
+    if (msg->type == MSG_ANSWER || msg->type == MSG_EXPIRED) {
+        conn->busy = false;
+        conn->answer_sent_ns = now_ns();
+        ++rp->tasks;
+        if (conn->drops && !conn->drop_busy && conn->task_k == conn->drop_task)
+            conn_schedule_drop(rp, conn_i, conn->answer_sent_ns);
+        conn_start_task(rp, conn_i);
+        return;
+    }
+    if (next) {
+        conn->due_ns = conn->task_start_ns + scaled(rp, next->offset_ns);
+        timer_push(rp, conn->due_ns, conn_i, TIMER_ACTION);
+    }
+}
+
+// Чтение задач; содержимое задач не используется.
+static void conn_readable(struct replay *rp, size_t conn_i)
+{
+    struct replay_conn *conn = &rp->conns[conn_i];
+    char scratch[65536];
+
+    while (conn->state == CONN_READY) {
+        ssize_t ret;
+        if (!conn->reading_body) {
+            ret = recv(conn->fd, (char *)&conn->size + conn->got, sizeof(conn->size) - conn->got, MSG_DONTWAIT);
+        } else {
+            size_t left = conn->size - conn->got;
+            ret = recv(conn->fd, scratch, left < sizeof(scratch) ? left : sizeof(scratch), MSG_DONTWAIT);
+        }
+        if (ret == 0) {
+            conn_finish(rp, conn, false);
+            return;
+        }
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                conn_finish(rp, conn, true);
+            return;
+        }
+        conn->got += ret;
+
+        if (!conn->reading_body && conn->got == sizeof(conn->size)) {
+            if (conn->size == TASK_SIZE_END || conn->size == TASK_SIZE_CANCEL) {
+                conn_finish(rp, conn, false);
+                return;
+            }
+            conn->reading_body = true;
+        }
+        if (conn->reading_body && conn->got == conn->size) {
+            if (conn->answer_sent_ns && !conn->busy && !conn->queued)
+                record_latency(rp, now_ns() - conn->answer_sent_ns);
+            conn->reading_body = false;
+            conn->got = 0;
+            conn->queued++;
+            conn_start_task(rp, conn_i);
+        }
+    }
+}
+
+static void conn_connect(struct replay *rp, size_t conn_i)
+{
+    struct replay_conn *conn = &rp->conns[conn_i];
+    conn->fd = socket(ADDR.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (conn->fd == -1) {
+        conn_finish(rp, conn, true);
+        return;
+    }
+    int arg = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &arg, sizeof(arg));
+    if (connect(conn->fd, (struct sockaddr *)&ADDR, ADDR_LEN) == -1 && errno != EINPROGRESS) {
+        conn_finish(rp, conn, true);
+        return;
+    }
+    conn->state = CONN_CONNECTING;
+    struct epoll_event ev = { .events = EPOLLOUT, .data.u64 = conn_i };
+    epoll_ctl(rp->epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev);
+}
+
+static void conn_connected(struct replay *rp, size_t conn_i)
+{
+    struct replay_conn *conn = &rp->conns[conn_i];
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    // Отправка выполняется блокирующими вызовами, приём - с MSG_DONTWAIT.
+    fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL) & ~O_NONBLOCK);
+    if (err || !send_all(conn->fd, &conn->info, sizeof(conn->info))) {
+        conn_finish(rp, conn, true);
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = conn_i };
+    epoll_ctl(rp->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->state = CONN_READY;
+    if (conn->drops && !conn->drop_busy && conn->drop_task == 0)
+        conn_schedule_drop(rp, conn_i, now_ns());
+}
+
+static void replay_run(struct replay *rp)
+{
+    struct epoll_event events[256];
+
+    rp->start_ns = now_ns();
+    for (size_t i = 0; i < rp->num_conns; ++i) {
+        struct replay_conn *conn = &rp->conns[i];
+        conn->fd = -1;
+        if (!conn->has_info) {
+            // Соединение без рукопожатия не влияет на распределение задач.
+            conn->state = CONN_DONE;
+            continue;
+        }
+        conn->state = CONN_WAIT_CONNECT;
+        conn->due_ns = rp->start_ns + scaled(rp, conn->connect_ns);
+        timer_push(rp, conn->due_ns, i, TIMER_ACTION);
+        ++rp->active;
+    }
+
+    while (rp->active) {
+        int timeout_ms = -1;
+        if (rp->num_timers) {
+            uint64_t now = now_ns();
+            uint64_t deadline = rp->timers[0].deadline_ns;
+            timeout_ms = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+        }
+
+        int n = epoll_wait(rp->epoll_fd, events, 256, timeout_ms);
+        if (n == -1 && errno != EINTR) {
+            fprintf(stderr, "[replay] epoll_wait failed\n");
+            break;
+        }
+        for (int e = 0; e < n; ++e) {
+            size_t conn_i = events[e].data.u64;
+            struct replay_conn *conn = &rp->conns[conn_i];
+            if (conn->state == CONN_CONNECTING && (events[e].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+                conn_connected(rp, conn_i);
+            else if (conn->state == CONN_READY && (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                conn_readable(rp, conn_i);
+        }
+
+        uint64_t now = now_ns();
+        while (rp->num_timers && rp->timers[0].deadline_ns <= now) {
+            struct timer timer = timer_pop(rp);
+            struct replay_conn *conn = &rp->conns[timer.conn_i];
+            if (conn->state == CONN_DONE)
+                continue;
+            if (timer.kind == TIMER_DROP) {
+                if (timer.deadline_ns == conn->drop_ns)
+                    conn_finish(rp, conn, false);
+                continue;
+            }
+            if (timer.deadline_ns != conn->due_ns)
+                continue;
+            if (conn->state == CONN_WAIT_CONNECT)
+                conn_connect(rp, timer.conn_i);
+            else
+                conn_action(rp, timer.conn_i);
+        }
+    }
+}
+
+//============================
+// Разбор аргументов и отчёт
+//============================
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint64_t *sorted, size_t n, double p)
+{
+    if (!n)
+        return 0;
+    size_t i = (size_t)ceil(p * n);
+    return sorted[i ? i - 1 : 0] / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4 && argc != 5) {
+        fprintf(stderr, "Usage: %s <address> <port> <record> [speed]\n", argv[0]);
+        return 1;
+    }
+    struct replay rp = { .speed = 1 };
+    if (argc == 5) {
+        rp.speed = atof(argv[4]);
+        if (rp.speed < 0) {
+            fprintf(stderr, "Speed should not be negative!\n");
+            return 1;
+        }
+    }
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(argv[1], argv[2], &hints, &res)) {
+        fprintf(stderr, "Unable to resolve %s:%s\n", argv[1], argv[2]);
+        return 1;
+    }
+    memcpy(&ADDR, res->ai_addr, res->ai_addrlen);
+    ADDR_LEN = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    if (load_record(&rp, argv[3]))
+        return 1;
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rp.num_conns + 64) {
+        rl.rlim_cur = rl.rlim_max < rp.num_conns + 64 ? rl.rlim_max : rp.num_conns + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    rp.epoll_fd = epoll_create1(0);
+    if (rp.epoll_fd == -1) {
+        fprintf(stderr, "Unable to create epoll\n");
+        return 1;
+    }
+    replay_run(&rp);
+    double elapsed = (now_ns() - rp.start_ns) / 1e9;
+
+    size_t n = rp.num_latencies;
+    qsort(rp.latencies, n, sizeof(*rp.latencies), cmp_u64);
+    printf("Connections: %lu (errors: %lu)\n", rp.num_conns, rp.errors);
+    printf("Tasks answered: %lu in %.3f s\n", rp.tasks, elapsed);
+    printf("Dispatch latency (answer -> next task), us: p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+            percentile_us(rp.latencies, n, 0.5), percentile_us(rp.latencies, n, 0.9),
+            percentile_us(rp.latencies, n, 0.99), percentile_us(rp.latencies, n, 0.999),
+            n ? rp.latencies[n - 1] / 1000.0 : 0);
+
+    for (size_t i = 0; i < rp.num_conns; ++i) {
+        free(rp.conns[i].msgs);
+        free(rp.conns[i].scripts);
+    }
+    close(rp.epoll_fd);
+    free(rp.conns);
+    free(rp.timers);
+    free(rp.latencies);
+    return 0;
+}
@@ -1,32 +1,238 @@
+#define _DEFAULT_SOURCE
 #include "lib/manager.h"
+#include "lib/quad.h"
+#include "lib/mc.h"
+#include "lib/batch.h"
+#include "lib/sampled.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 double LEFT  = 1;
 double RIGHT = 2000000;
+// Погрешность интеграла по остаточному члену выбранной формулы.
 double PRECISION = 0.0000001;
+// Худшая допустимая погрешность, если с PRECISION задание не успевает за max_time;
+// задание, которое не успевает и с ней, отклоняется до раздачи задач.
+double MAX_PRECISION = 0.001;
+// Количество задач на один рабочий узел: опоздавшие узлы забирают невыданные задачи.
+unsigned CHUNKS_PER_NODE = 4;
 
 struct task {
     size_t size_of_structure;
     double left;
     double step;
     uint64_t num_steps;
+    QUAD_RULE rule;
 };
 
-// Вычисление одного шага по формуле остаточного члена метода прямоугольников
-// f(x) = sin(x)
-static double get_step() {
-    double max_ddf = sin(RIGHT);
-    if (max_ddf == 0) {
-        return 1;
+// Отрезок для численного интегрирования и задачи, созданные при планировании.
+struct job_plan {
+    double left;
+    double right;
+    struct task *tasks;
+    double *ans;
+};
+
+static const char *RULE_NAMES[] = { "midpoint", "simpson" };
+
+// Планирование по профилям подключённых узлов f(x) = sin(x): формула, шаг и количество задач
+// выбираются по прогнозу времени; точность понижается или задание отклоняется, если не успевает.
+static int plan_job(MANAGER_JOB *job, const MANAGER_CLUSTER *cluster)
+{
+    struct job_plan *plan = job->plan_arg;
+    // Узлы без профиля считаются такими же, как узлы с профилем.
+    QUAD_COST_BUDGET budget = {
+        .evals_per_sec = cluster->profiled_cores ?
+            cluster->evals_per_sec[SIN] * cluster->num_cores / cluster->profiled_cores : 0,
+        .num_nodes = cluster->num_nodes,
+        .seconds = cluster->time_left,
+    };
+    QUAD_COST_PLAN cost;
+    if (quad_cost_plan(SIN, plan->left, plan->right, PRECISION, MAX_PRECISION, &budget, CHUNKS_PER_NODE, &cost)) {
+        printf("Rejected: %.1lfs needed for precision %lg, %.1lfs left\n", cost.seconds, cost.tolerance,
+                cluster->time_left);
+        return -1;
+    }
+    printf("Plan: %s, %lu steps, %lu tasks, precision %lg", RULE_NAMES[cost.rule], cost.num_steps,
+            cost.num_tasks, cost.tolerance);
+    if (cost.status == QUAD_COST_UNKNOWN)
+        printf(", no worker profiles\n");
+    else
+        printf(", predicted %.2lfs%s\n", cost.seconds, cost.status == QUAD_COST_DOWNGRADED ? " (downgraded)" : "");
+
+    plan->tasks = calloc(cost.num_tasks, sizeof(*plan->tasks));
+    plan->ans = calloc(cost.num_tasks, sizeof(*plan->ans));
+    if (!plan->tasks || !plan->ans)
+        return -1;
+
+    double left = plan->left;
+    for (unsigned i = 0; i < cost.num_tasks; ++i) {
+        plan->tasks[i].left = left;
+        plan->tasks[i].step = cost.step;
+        plan->tasks[i].rule = cost.rule;
+        plan->tasks[i].num_steps = cost.num_steps / cost.num_tasks;
+        if (i < cost.num_steps % cost.num_tasks)
+            ++plan->tasks[i].num_steps;
+        plan->tasks[i].size_of_structure = sizeof(*plan->tasks);
+        left += cost.step * plan->tasks[i].num_steps;
+    }
+    job->size_of_structure = sizeof(*plan->tasks);
+    job->num_tasks = cost.num_tasks;
+    job->tasks = (char *)plan->tasks;
+    job->ans = (char *)plan->ans;
+    job->ans_capacity = cost.num_tasks * sizeof(*plan->ans);
+    return 0;
+}
+
+//============================
+// Задания модулей библиотеки (SPECSEM_JOB); рабочие узлы запускаются с тем же значением.
+//============================
+// Квази-Монте-Карло: гауссиана exp(-sum((x[i] - 0.5)^2)) на [0, 1]^MC_DIMS, точное значение
+// (sqrt(pi) * erf(1/2))^MC_DIMS должно попасть в доверительный интервал 95%.
+#define MC_DIMS 4
+#define MC_SAMPLES (1U << 16)
+
+static int run_mc(INFO_MANAGER *manager)
+{
+    double lower[MC_DIMS], upper[MC_DIMS];
+    for (int i = 0; i < MC_DIMS; ++i) {
+        lower[i] = 0;
+        upper[i] = 1;
+    }
+    struct mc_task job;
+    if (mc_job_init(&job, MC_SOBOL, MC_GAUSSIAN, MC_DIMS, lower, upper, MC_SAMPLES, 42))
+        return -1;
+
+    size_t num_tasks = manager->num_nodes * CHUNKS_PER_NODE;
+    struct mc_task *tasks = calloc(num_tasks, sizeof(*tasks));
+    struct mc_result *results = calloc(num_tasks, sizeof(*results));
+    MC_ESTIMATE est;
+    int ret = -1;
+    if (tasks && results && !mc_make_tasks(&job, num_tasks, tasks) &&
+            !start_manager_bounded(manager, sizeof(*tasks), num_tasks, (char *)tasks, (char *)results,
+                num_tasks * sizeof(*results)) &&
+            !mc_estimate(&job, results, num_tasks, 1.96, &est)) {
+        double expected = pow(sqrt(M_PI) * erf(0.5), MC_DIMS);
+        printf("Result: %.8lf +- %lg (95%%: %.8lf..%.8lf, %lu evals), expected %.8lf\n", est.value, est.std_error,
+                est.ci_low, est.ci_high, est.evals, expected);
+        ret = est.ci_low <= expected && expected <= est.ci_high ? 0 : -1;
+    }
+    free(tasks);
+    free(results);
+    return ret;
+}
+
+// Пакет интегралов exp, sin и x^2 на отрезках [k / 2, k / 2 + 1] без упрощений до раздачи:
+// каждая запись сверяется с первообразной.
+#define BATCH_RECORDS 24
+#define BATCH_TOLERANCE 1e-7
+
+static double batch_expected(FUNC_TABLE func, double left, double right)
+{
+    switch (func) {
+    case EXP:
+        return exp(right) - exp(left);
+    case SIN:
+        return cos(left) - cos(right);
+    case SQR:
+        return (right * right * right - left * left * left) / 3;
+    default:
+        return NAN;
+    }
+}
+
+static int run_batch(INFO_MANAGER *manager)
+{
+    BATCH_RECORD records[BATCH_RECORDS];
+    BATCH_RESULT results[BATCH_RECORDS];
+    for (size_t i = 0; i < BATCH_RECORDS; ++i) {
+        records[i] = (BATCH_RECORD){
+            .func = i % NOT_SUPPORT,
+            .left = i / 2.0,
+            .right = i / 2.0 + 1,
+            .tolerance = BATCH_TOLERANCE,
+            .plan = 0,
+        };
     }
-    return sqrt(24 * PRECISION / fabs(max_ddf));
+    if (start_manager_batch(manager, BATCH_RECORDS, records, results))
+        return -1;
+
+    int ret = 0;
+    uint64_t num_steps = 0;
+    for (size_t i = 0; i < BATCH_RECORDS; ++i) {
+        num_steps += results[i].num_steps;
+        double expected = batch_expected(records[i].func, records[i].left, records[i].right);
+        // Погрешность формулы не больше tolerance; запас - на округление суммы.
+        if (!(fabs(results[i].value - expected) <= 2 * BATCH_TOLERANCE * fmax(1, fabs(expected)))) {
+            printf("Record %lu: %lf, expected %lf\n", i, results[i].value, expected);
+            ret = -1;
+        }
+    }
+    printf("Result: %d records%s (%lu steps)\n", BATCH_RECORDS, ret ? " with errors" : " match", num_steps);
+    return ret;
+}
+
+// Файл выборок sin(x) на [0, SAMPLED_RIGHT] с неравномерной сеткой x = SAMPLED_RIGHT * t^2
+// (формула Симпсона для неравномерной сетки); точное значение 1 - cos(SAMPLED_RIGHT).
+// Файл создаётся по пути SPECSEM_SAMPLES (по умолчанию build/samples.bin), доступному узлам.
+#define SAMPLED_RIGHT 10.0
+#define SAMPLED_POINTS ((1U << 18) + 1)
+
+static int run_sampled(INFO_MANAGER *manager)
+{
+    const char *path = getenv("SPECSEM_SAMPLES");
+    if (!path)
+        path = "build/samples.bin";
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Unable to create %s\n", path);
+        return -1;
+    }
+    bool written = true;
+    for (uint32_t i = 0; i < SAMPLED_POINTS && written; ++i) {
+        double t = (double)i / (SAMPLED_POINTS - 1);
+        double sample[2] = { SAMPLED_RIGHT * t * t, sin(SAMPLED_RIGHT * t * t) };
+        written = fwrite(sample, sizeof(sample), 1, file) == 1;
+    }
+    if (fclose(file) || !written) {
+        fprintf(stderr, "Unable to write %s\n", path);
+        return -1;
+    }
+
+    size_t num_tasks = manager->num_nodes * CHUNKS_PER_NODE;
+    struct sampled_task *tasks = calloc(num_tasks, sizeof(*tasks));
+    double *ans = calloc(num_tasks, sizeof(*ans));
+    int ret = -1;
+    if (tasks && ans && !sampled_make_tasks(path, SAMPLED_SIMPSON, 0, num_tasks, tasks) &&
+            !start_manager_bounded(manager, sizeof(*tasks), num_tasks, (char *)tasks, (char *)ans,
+                num_tasks * sizeof(*ans))) {
+        double res = 0;
+        for (size_t i = 0; i < num_tasks; ++i)
+            res += ans[i];
+        double expected = 1 - cos(SAMPLED_RIGHT);
+        printf("Result: %.10lf, expected %.10lf\n", res, expected);
+        ret = fabs(res - expected) <= 1e-9 ? 0 : -1;
+    }
+    free(tasks);
+    free(ans);
+    remove(path);
+    return ret;
 }
 
+static const struct {
+    const char *name;
+    int (*run)(INFO_MANAGER *manager);
+} JOBS[] = {
+    { "mc", run_mc },
+    { "batch", run_batch },
+    { "sampled", run_sampled },
+};
+
 int main(int argc, char *argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <address> <port> <max_time> <num_nodes>\n", argv[0]);
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "Usage: %s <address> <port> <max_time> <num_nodes> [min_nodes]\n", argv[0]);
         return 1;
     }
     char *addr = argv[1];
@@ -48,36 +254,62 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Unable to init manager\n");
         return 1;
     }
-    double step = get_step();
-    uint64_t num_steps = (uint64_t)(ceil(fabs(RIGHT - LEFT) / step)) + 2;
-    step = (RIGHT - LEFT) / num_steps;
-
-    struct task *tasks = calloc(num_nodes, sizeof(*tasks));
-    if (!tasks) return 1;
-    
-    double left = LEFT;
-    for (unsigned i = 0; i < num_nodes; ++i) {
-        tasks[i].left = left;
-        tasks[i].step = step;
-        tasks[i].num_steps = num_steps / num_nodes;
-        if (i < num_steps % num_nodes)
-            ++tasks[i].num_steps;
-        tasks[i].size_of_structure = sizeof(*tasks);
-        left += step * tasks[i].num_steps;
-    }
-
-    double *ans = calloc(num_nodes, sizeof(*ans));
-    if (start_manager(&info_manager, sizeof(*tasks), num_nodes, (char *)tasks, (char *)ans) < 0) {
-        free(tasks);
-        free(ans);
+    if (argc == 6) {
+        // Старт с кворумом: ждём остальные узлы не дольше двух секунд.
+        info_manager.min_nodes = atol(argv[5]);
+        info_manager.grace_ms = 2000;
+    }
+    const char *job_name = getenv("SPECSEM_JOB");
+    if (job_name && strcmp(job_name, "quad")) {
+        for (size_t i = 0; i < sizeof(JOBS) / sizeof(JOBS[0]); ++i) {
+            if (!strcmp(job_name, JOBS[i].name)) {
+                if (JOBS[i].run(&info_manager)) {
+                    printf("Error in %s job!\n", job_name);
+                    return 1;
+                }
+                return 0;
+            }
+        }
+        fprintf(stderr, "Unknown job %s\n", job_name);
+        return 1;
+    }
+    // Необязательное упрощение интеграла до раздачи задач (SPECSEM_PLAN=periodic|analytic).
+    QUAD_PLAN plan;
+    quad_plan(SIN, LEFT, RIGHT, quad_plan_parse(getenv("SPECSEM_PLAN")), &plan);
+    if (plan.left == plan.right) {
+        // Интеграл найден целиком, рабочие узлы не нужны.
+        printf("Result: %lf\n", plan.known);
+        return 0;
+    }
+
+    // Задачи создаются при старте, когда известны подключённые узлы и их профили.
+    MANAGER_SCHED *sched = manager_sched_create();
+    if (!sched) return 1;
+    struct job_plan job_plan = { .left = plan.left, .right = plan.right };
+    // По истечении времени возвращается оценка по промежуточным результатам узлов.
+    MANAGER_ESTIMATE estimate;
+    MANAGER_JOB job = { .weight = 1, .estimate = &estimate, .plan = plan_job, .plan_arg = &job_plan };
+    int ret = manager_sched_submit(sched, &job);
+    manager_sched_close(sched);
+    if (ret == 0)
+        start_manager_sched(&info_manager, sched);
+    manager_sched_destroy(sched);
+    ret = ret == 0 && job.done ? job.status : -1;
+    free(job_plan.tasks);
+    free(job_plan.ans);
+    if (info_manager.latency.count) {
+        printf("Latency: p50=%.1lfus p99=%.1lfus max=%.1lfus (%lu answers)\n",
+                info_manager.latency.p50_ns / 1e3, info_manager.latency.p99_ns / 1e3,
+                info_manager.latency.max_ns / 1e3, info_manager.latency.count);
+    }
+    if (ret < 0) {
         printf("Error in start manager!\n");
         return 1;
     }
-    double res = 0;
-    for (int i = 0; i < num_nodes; ++i) {
-        res += ans[i];
+    if (ret == 1) {
+        printf("Estimate: %lf +- %lf (coverage %.1lf%%)\n", plan.known + estimate.value, estimate.error,
+                100 * estimate.coverage);
+        return 0;
     }
-    free(tasks);
-    free(ans);
-    printf("Result: %lf\n", res);
+    printf("Result: %lf\n", plan.known + estimate.value);
 }
@@ -3,9 +3,16 @@
 #include <time.h>
 #include <stdint.h>
 #include <math.h>
+#include <string.h>
 
 #include "lib/common.h"
 #include "lib/worker.h"
+#include "lib/quad.h"
+#include "lib/log.h"
+#include "lib/profile.h"
+#include "lib/mc.h"
+#include "lib/batch.h"
+#include "lib/sampled.h"
 
 
 // node = "127.0.0.1"
@@ -19,6 +26,8 @@ struct task {
     double left;
     double step;
     uint64_t parts;
+    // Квадратурная формула, выбранная планировщиком Управляющего узла.
+    QUAD_RULE rule;
 };
 
 // Данные исполнителя
@@ -37,21 +46,35 @@ void add_func(char *a, char *b)
 void *func(void *t_args)
 {
     time_t start_time = time(NULL);
-    printf("Begin counting\n");
+    LOG_DEBUG("Begin counting");
     double result = 0;
     struct task *args = (struct task *) t_args;
-    printf("step=%lf, left=%lf, parts=%lld\n", args->step, args->left, args->parts);
+    LOG_DEBUG("step=%lf, left=%lf, parts=%lu", args->step, args->left, args->parts);
     double left = args->left;
     double step = args->step;
     double parts = args->parts;
-    double x = left + step / 2;
-    for (long long i = 0; i < parts; ++i) {
-        result += step * sin(x);
-        x += step;
+    if (args->rule == QUAD_RULE_SIMPSON) {
+        result = quad_simpson(SIN, left, step, args->parts);
+        if (isnan(result))
+            return NULL;
+    } else if (worker.partial_ms) {
+        // Грубые уровни сначала: оценка всей части доступна Управляющему узлу до конца вычисления.
+        result = quad_midpoint_anytime(SIN, left, step, args->parts);
+        if (isnan(result))
+            return NULL;
+    } else {
+        double x = left + step / 2;
+        for (long long i = 0; i < parts; ++i) {
+            // Проверка отмены раз в блок итераций.
+            if (!(i & (WORKER_CANCEL_BLOCK - 1)) && worker_cancelled())
+                return NULL;
+            result += step * sin(x);
+            x += step;
+        }
     }
 
     worker_add_result(&worker, (char *)&result, add_func);
-    fprintf(stderr, "TIME #: %ds\n", time(NULL) - start_time);
+    LOG_DEBUG("TIME #: %lds", (long)(time(NULL) - start_time));
     return NULL;
 }
 
@@ -70,6 +93,7 @@ int data_for_threads(INFO_WORKER *worker)
     for (int i = 0; i < worker->n_cores; ++i) {
         tasks[i].left = left;
         tasks[i].step = task->step;
+        tasks[i].rule = task->rule;
         tasks[i].parts = task->parts / worker->n_cores;
         if (i < task->parts % worker->n_cores)
             ++tasks[i].parts;
@@ -82,6 +106,90 @@ int data_for_threads(INFO_WORKER *worker)
     return 0;
 }
 
+//============================
+// Задания модулей библиотеки (SPECSEM_JOB, как у Управляющего узла).
+//============================
+static int mc_collect_job(INFO_WORKER *worker)
+{
+    mc_collect(worker);
+    return 0;
+}
+
+static int sampled_collect_job(INFO_WORKER *worker)
+{
+    sampled_collect(worker);
+    return 0;
+}
+
+struct job_kind {
+    const char *name;
+    size_t size_of_structure;
+    size_t size_of_result;
+    int (*data_for_threads)(INFO_WORKER *worker);
+    void *(*thread_func)(void *t_args);
+    // Формирование ответа после вычисления (NULL - ответ собирает worker_add_result).
+    int (*collect)(INFO_WORKER *worker);
+    // Освобождение ресурсов задачи, если ответ не собирается (вычисление отменено).
+    void (*release)(INFO_WORKER *worker);
+};
+
+static const struct job_kind JOBS[] = {
+    { "quad", sizeof(struct task), sizeof(double), data_for_threads, func, NULL, NULL },
+    { "mc", sizeof(struct mc_task), sizeof(struct mc_result), mc_data_for_threads, mc_thread_func, mc_collect_job,
+        NULL },
+    { "batch", sizeof(struct batch_task), sizeof(struct batch_result), batch_data_for_threads, batch_thread_func,
+        batch_collect, NULL },
+    { "sampled", sizeof(struct sampled_task), sizeof(double), sampled_data_for_threads, sampled_thread_func,
+        sampled_collect_job, sampled_release },
+};
+
+//============================
+// Локальное выполнение.
+//============================
+// Интеграл sin на [LEFT, RIGHT] с точностью PRECISION считается в пуле start_local
+// и сравнивается с точным значением cos(LEFT) - cos(RIGHT).
+int run_local(int n_cores, time_t max_time)
+{
+    // Остаточный член метода прямоугольников: (RIGHT - LEFT) * step^2 * max|f''| / 24, |sin''| <= 1.
+    double step = sqrt(24 * PRECISION / (RIGHT - LEFT));
+    uint64_t num_steps = (uint64_t)ceil((RIGHT - LEFT) / step);
+    step = (RIGHT - LEFT) / num_steps;
+    size_t num_tasks = 4 * n_cores;
+
+    struct task *tasks = calloc(num_tasks, sizeof(*tasks));
+    double *ans = calloc(num_tasks, sizeof(*ans));
+    if (!tasks || !ans) {
+        free(tasks);
+        free(ans);
+        return -1;
+    }
+    double left = LEFT;
+    for (size_t i = 0; i < num_tasks; ++i) {
+        tasks[i].size_of_structure = sizeof(*tasks);
+        tasks[i].left = left;
+        tasks[i].step = step;
+        tasks[i].rule = QUAD_RULE_MIDPOINT;
+        tasks[i].parts = num_steps / num_tasks;
+        if (i < num_steps % num_tasks)
+            ++tasks[i].parts;
+        left += step * tasks[i].parts;
+    }
+
+    int ret = start_local(sizeof(*tasks), sizeof(*ans), num_tasks, (char *)tasks, (char *)ans,
+            n_cores, max_time, func);
+    double res = 0;
+    for (size_t i = 0; i < num_tasks; ++i)
+        res += ans[i];
+    free(tasks);
+    free(ans);
+    if (ret)
+        return -1;
+
+    double expected = cos(LEFT) - cos(RIGHT);
+    printf("[WORKER] local result %lf, expected %lf\n", res, expected);
+    return fabs(res - expected) <= PRECISION ? 0 : -1;
+}
+
 //============================
 // Основная процедура исполнителя.
 //============================
@@ -92,8 +200,29 @@ int main( int argc, char** argv)
     test();
 #else
     time_t max_time = 10;
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <address> <port> <num_cores>\n", argv[0]);
+    if (argc == 3 && !strcmp(argv[1], "calibrate")) {
+        // Калибровка: профиль узла сохраняется и передаётся Управляющему узлу при следующих подключениях.
+        worker.n_cores = atol(argv[2]);
+        if (worker_calibrate(&worker)) {
+            fprintf(stderr, "[worker_calibrate] error\n");
+            return EXIT_FAILURE;
+        }
+        printf("[WORKER] profile %s: exp=%.3le sin=%.3le sqr=%.3le evals/s per core\n", profile_path(),
+                worker.evals_per_sec[EXP], worker.evals_per_sec[SIN], worker.evals_per_sec[SQR]);
+        return EXIT_SUCCESS;
+    }
+    if ((argc == 3 || argc == 4) && !strcmp(argv[1], "local")) {
+        // Выполнение в текущем процессе, без Управляющего узла.
+        if (run_local(atol(argv[2]), argc == 4 ? atol(argv[3]) : max_time)) {
+            fprintf(stderr, "[start_local] error\n");
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc < 4 || argc > 6) {
+        fprintf(stderr, "Usage: %s <address> <port> <num_cores> [credits] [max_time]\n"
+                "       %s calibrate <num_cores>\n"
+                "       %s local <num_cores> [max_time]\n", argv[0], argv[0], argv[0]);
         return 1;
     }
     int n_cores = atol(argv[3]);
@@ -101,36 +230,83 @@ int main( int argc, char** argv)
         fprintf(stderr, "Number of nodes should be positive!\n");
         return 1;
     }
+    const char *job_name = getenv("SPECSEM_JOB");
+    const struct job_kind *job = &JOBS[0];
+    for (size_t i = 0; job_name && i < sizeof(JOBS) / sizeof(JOBS[0]); ++i) {
+        if (!strcmp(job_name, JOBS[i].name))
+            job = &JOBS[i];
+    }
+    if (job_name && strcmp(job_name, job->name)) {
+        fprintf(stderr, "Unknown job %s\n", job_name);
+        return 1;
+    }
 
-    if (init_worker(&worker, sizeof(struct task), sizeof(double), n_cores, max_time, argv[1], argv[2])) {
+    if (init_worker(&worker, job->size_of_structure, job->size_of_result, n_cores, max_time, argv[1], argv[2])) {
         fprintf(stderr, "[init_worker] error\n");
         return EXIT_FAILURE;
     }
+    if (argc >= 5) {
+        worker.credits = atol(argv[4]);
+    }
+    if (argc == 6) {
+        worker.max_time = atol(argv[5]);
+    }
 
-    if (connect_to_server(&worker)) {
+    int ret = connect_to_server(&worker);
+    if (ret < 0) {
         fprintf(stderr, "[connect_to_server] error\n");
         return EXIT_FAILURE;
     }
 
-    if (data_for_threads(&worker)) {
-        fprintf(stderr, "[data_for_threads] error\n");
-        return EXIT_FAILURE;
-    }
+    // Задачи выполняются по одной (следующие принимаются заранее), пока у Управляющего узла они не закончатся.
+    while (ret == 0) {
+        if (job->data_for_threads(&worker)) {
+            fprintf(stderr, "[data_for_threads] error\n");
+            return EXIT_FAILURE;
+        }
 
-    // Вычисление результата
-    if (distributed_counting(&worker, func)) {
-        fprintf(stderr, "[distributed_counting] error\n");
-        worker_close(&worker);
-        return EXIT_FAILURE;
-    }
+        // Вычисление результата
+        ret = distributed_counting(&worker, job->thread_func);
+        if (ret && job->release)
+            job->release(&worker);
+        if (ret == 1) {
+            // Задание отменено: соединение закрывается.
+            fprintf(stderr, "[WORKER] computation cancelled\n");
+            break;
+        }
+        if (ret == 2) {
+            // Задача не уложилась в max_time: она достанется другому узлу, а этот узел продолжает работу.
+            fprintf(stderr, "[WORKER] task deadline expired\n");
+            if (send_expired(&worker)) {
+                worker_close(&worker);
+                return EXIT_FAILURE;
+            }
+        } else if (ret) {
+            fprintf(stderr, "[distributed_counting] error\n");
+            worker_close(&worker);
+            return EXIT_FAILURE;
+        } else {
+            if (job->collect && job->collect(&worker)) {
+                fprintf(stderr, "[collect] error\n");
+                worker_close(&worker);
+                return EXIT_FAILURE;
+            }
 
-    // Отправка результата
-    if (send_result(&worker)) {
-        fprintf(stderr, "[send_result] error\n");
-        worker_close(&worker);
-        return EXIT_FAILURE;
+            // Отправка результата
+            if (send_result(&worker)) {
+                fprintf(stderr, "[send_result] error\n");
+                worker_close(&worker);
+                return EXIT_FAILURE;
+            }
+            LOG_INFO("[WORKER] Sent %s answer of %lu bytes", job->name, worker.size_of_result);
+        }
+
+        ret = get_task(&worker);
+        if (ret < 0) {
+            fprintf(stderr, "[get_task] error\n");
+            return EXIT_FAILURE;
+        }
     }
-    printf("[WORKER] Sent answer %lf\n", *(double *)worker.result);
     worker_close(&worker);
 
 #endif // TEST